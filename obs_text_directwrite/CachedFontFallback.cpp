@@ -0,0 +1,250 @@
+#include "CachedFontFallback.h"
+
+#include <wchar.h>
+
+#include "ContentHash.h"
+#include "CustomTextRenderer.h"
+
+CachedFontFallback *CachedFontFallback::instance = nullptr;
+
+/* codepoints whose font depends on the character before them */
+static inline bool is_dependent(UINT32 cp) {
+  return (cp >= 0x0300 && cp <= 0x036F) || (cp >= 0x1AB0 && cp <= 0x1AFF) ||
+         (cp >= 0x1DC0 && cp <= 0x1DFF) || (cp >= 0x200C && cp <= 0x200D) ||
+         (cp >= 0x20D0 && cp <= 0x20FF) || (cp >= 0xFE00 && cp <= 0xFE0F) ||
+         (cp >= 0xFE20 && cp <= 0xFE2F) || (cp >= 0x1F3FB && cp <= 0x1F3FF) ||
+         (cp >= 0xE0020 && cp <= 0xE007F) || (cp >= 0xE0100 && cp <= 0xE01EF);
+}
+
+static inline UINT32 decode(const WCHAR *text, UINT32 len, UINT32 i,
+                            UINT32 *units) {
+  if (IS_HIGH_SURROGATE(text[i]) && i + 1 < len &&
+      IS_LOW_SURROGATE(text[i + 1])) {
+    *units = 2;
+    return 0x10000 + (((UINT32)text[i] - 0xD800) << 10) +
+           ((UINT32)text[i + 1] - 0xDC00);
+  }
+  *units = 1;
+  return text[i];
+}
+
+CachedFontFallback *CachedFontFallback::Get(IDWriteFactory2 *pDWriteFactory) {
+  if (!instance) {
+    IDWriteFontFallback *pSystemFallback = nullptr;
+    if (FAILED(pDWriteFactory->GetSystemFontFallback(&pSystemFallback)))
+      return nullptr;
+
+    instance = new CachedFontFallback(pSystemFallback);
+    instance->AddRef();
+    SafeRelease(&pSystemFallback);
+  }
+  return instance;
+}
+
+void CachedFontFallback::Shutdown() { SafeRelease(&instance); }
+
+CachedFontFallback::CachedFontFallback(IDWriteFontFallback *pSystemFallback_)
+    : cRefCount_(0), pSystemFallback(pSystemFallback_) {
+  pSystemFallback->AddRef();
+}
+
+CachedFontFallback::~CachedFontFallback() {
+  for (auto &table : tables) ReleaseTable(table.second);
+  SafeRelease(&pSystemFallback);
+}
+
+void CachedFontFallback::ReleaseTable(Table &table) {
+  for (auto &mapping : table.fonts) SafeRelease(&mapping.font);
+}
+
+/* node, key and bucket of each codepoint, plus the font list and names */
+size_t CachedFontFallback::TableBytes(const Table &table) {
+  return table.codepoints.size() * (sizeof(std::pair<UINT32, size_t>) +
+                                    3 * sizeof(void *)) +
+         table.fonts.capacity() * sizeof(Mapping) +
+         (table.format.family.capacity() + table.format.locale.capacity()) *
+             sizeof(wchar_t) +
+         sizeof(Table);
+}
+
+size_t CachedFontFallback::MemoryBytes() {
+  if (!instance) return 0;
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  size_t bytes = 0;
+  for (auto &table : instance->tables) bytes += TableBytes(table.second);
+  return bytes;
+}
+
+size_t CachedFontFallback::EvictOldest() {
+  if (!instance) return 0;
+
+  std::lock_guard<std::mutex> lock(instance->mutex);
+  auto oldest = instance->tables.end();
+  for (auto it = instance->tables.begin(); it != instance->tables.end(); ++it) {
+    if (oldest == instance->tables.end() ||
+        it->second.last_used < oldest->second.last_used)
+      oldest = it;
+  }
+  if (oldest == instance->tables.end()) return 0;
+
+  size_t bytes = TableBytes(oldest->second);
+  ReleaseTable(oldest->second);
+  instance->tables.erase(oldest);
+  return bytes;
+}
+
+size_t CachedFontFallback::AddMapping(Table &table, IDWriteFont *font,
+                                      float scale) {
+  IDWriteFont3 *font3 = nullptr;
+  if (font) font->QueryInterface<IDWriteFont3>(&font3);
+
+  size_t index = 0;
+  for (; index < table.fonts.size(); index++) {
+    const Mapping &mapping = table.fonts[index];
+    if (mapping.scale != scale) continue;
+    if (mapping.font == font) break;
+    if (font3 && mapping.font && font3->Equals(mapping.font)) break;
+  }
+  SafeRelease(&font3);
+
+  if (index == table.fonts.size()) {
+    if (font) font->AddRef();
+    table.fonts.push_back({font, scale});
+  }
+  return index;
+}
+
+IFACEMETHODIMP CachedFontFallback::MapCharacters(
+    IDWriteTextAnalysisSource *analysisSource, UINT32 textPosition,
+    UINT32 textLength, __maybenull IDWriteFontCollection *baseFontCollection,
+    __maybenull wchar_t const *baseFamilyName, DWRITE_FONT_WEIGHT baseWeight,
+    DWRITE_FONT_STYLE baseStyle, DWRITE_FONT_STRETCH baseStretch,
+    __out UINT32 *mappedLength, __out IDWriteFont **mappedFont,
+    __out FLOAT *scale) {
+  const WCHAR *text = nullptr;
+  UINT32 len = 0;
+  const WCHAR *locale = nullptr;
+  UINT32 locale_run = 0;
+
+  analysisSource->GetTextAtPosition(textPosition, &text, &len);
+  analysisSource->GetLocaleName(textPosition, &locale_run, &locale);
+  if (len > textLength) len = textLength;
+
+  const wchar_t *family = baseFamilyName ? baseFamilyName : L"";
+  if (!locale) locale = L"";
+  size_t family_len = wcslen(family);
+  size_t locale_len = wcslen(locale);
+
+  UINT32 attributes[4] = {(UINT32)family_len, (UINT32)baseWeight,
+                          (UINT32)baseStyle, (UINT32)baseStretch};
+  ContentHash hash;
+  hash.Update(attributes, sizeof(attributes));
+  hash.Update(family, family_len * sizeof(wchar_t));
+  hash.Update(locale, locale_len * sizeof(wchar_t));
+  uint64_t key = hash.Digest();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto slot = tables.find(key);
+  if (slot == tables.end()) {
+    slot = tables.emplace(key, Table()).first;
+    slot->second.format = {family, locale, baseWeight, baseStyle,
+                           baseStretch};
+  }
+
+  /* a format whose hash collides with another table's is not cached */
+  const Format &format = slot->second.format;
+  if (format.weight != baseWeight || format.style != baseStyle ||
+      format.stretch != baseStretch || format.family.size() != family_len ||
+      format.locale.size() != locale_len ||
+      wmemcmp(format.family.data(), family, family_len) ||
+      wmemcmp(format.locale.data(), locale, locale_len))
+    return pSystemFallback->MapCharacters(
+        analysisSource, textPosition, textLength, baseFontCollection,
+        baseFamilyName, baseWeight, baseStyle, baseStretch, mappedLength,
+        mappedFont, scale);
+
+  Table &table = slot->second;
+  table.last_used = ++use_counter;
+
+  /* walk cached codepoints while they agree on one font; a cluster that
+   * continues with a dependent codepoint is left to the system fallback */
+  UINT32 covered = 0;
+  size_t font_index = 0;
+  for (UINT32 i = 0, units = 0; text && i < len; i += units) {
+    UINT32 cp = decode(text, len, i, &units);
+    if (is_dependent(cp)) break;
+
+    UINT32 next = i + units;
+    if (next < len) {
+      UINT32 next_units;
+      if (is_dependent(decode(text, len, next, &next_units))) break;
+    } else if (len < textLength) {
+      break;
+    }
+
+    auto found = table.codepoints.find(cp);
+    if (found == table.codepoints.end()) break;
+    if (covered && found->second != font_index) break;
+
+    font_index = found->second;
+    covered = next;
+  }
+
+  if (covered) {
+    const Mapping &mapping = table.fonts[font_index];
+    *mappedLength = covered;
+    *mappedFont = mapping.font;
+    *scale = mapping.scale;
+    if (mapping.font) mapping.font->AddRef();
+    return S_OK;
+  }
+
+  HRESULT hr = pSystemFallback->MapCharacters(
+      analysisSource, textPosition, textLength, baseFontCollection,
+      baseFamilyName, baseWeight, baseStyle, baseStretch, mappedLength,
+      mappedFont, scale);
+  if (FAILED(hr) || !text) return hr;
+
+  /* remember the codepoints whose mapping did not depend on a neighbour */
+  UINT32 mapped = *mappedLength < len ? *mappedLength : len;
+  size_t index = AddMapping(table, *mappedFont, *scale);
+  for (UINT32 i = 0, units = 0; i < mapped; i += units) {
+    UINT32 cp = decode(text, len, i, &units);
+    UINT32 next = i + units;
+    UINT32 next_units;
+    if (is_dependent(cp) ||
+        (next < len && is_dependent(decode(text, len, next, &next_units))))
+      continue;
+
+    table.codepoints.emplace(cp, index);
+  }
+
+  return hr;
+}
+
+IFACEMETHODIMP_(unsigned long) CachedFontFallback::AddRef() {
+  return InterlockedIncrement(&cRefCount_);
+}
+
+IFACEMETHODIMP_(unsigned long) CachedFontFallback::Release() {
+  unsigned long newCount = InterlockedDecrement(&cRefCount_);
+  if (newCount == 0) {
+    delete this;
+    return 0;
+  }
+
+  return newCount;
+}
+
+IFACEMETHODIMP CachedFontFallback::QueryInterface(IID const &riid,
+                                                  void **ppvObject) {
+  if (__uuidof(IDWriteFontFallback) == riid || __uuidof(IUnknown) == riid) {
+    *ppvObject = this;
+    this->AddRef();
+    return S_OK;
+  } else {
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <dwrite_2.h>
+#include <dwrite_3.h>
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Font fallback that remembers which font the system fallback picked for
+ * each codepoint.
+ *
+ * One table exists per base format (family, weight, style, stretch and
+ * locale) and is shared by every source using that format. Runs made only
+ * of codepoints already seen are answered from the table; anything else,
+ * including clusters with joiners, variation selectors or combining marks
+ * whose font depends on context, is handed to the system fallback and the
+ * context-free part of its answer recorded. */
+class CachedFontFallback : public IDWriteFontFallback {
+ public:
+  static CachedFontFallback *Get(IDWriteFactory2 *pDWriteFactory);
+  static void Shutdown();
+
+  /* estimated size of all tables, and dropping of the least recently used
+   * one for the memory budget; both return bytes */
+  static size_t MemoryBytes();
+  static size_t EvictOldest();
+
+  IFACEMETHOD(MapCharacters)
+  (IDWriteTextAnalysisSource *analysisSource, UINT32 textPosition,
+   UINT32 textLength, __maybenull IDWriteFontCollection *baseFontCollection,
+   __maybenull wchar_t const *baseFamilyName, DWRITE_FONT_WEIGHT baseWeight,
+   DWRITE_FONT_STYLE baseStyle, DWRITE_FONT_STRETCH baseStretch,
+   __out UINT32 *mappedLength, __out IDWriteFont **mappedFont,
+   __out FLOAT *scale);
+
+  IFACEMETHOD_(unsigned long, AddRef)();
+  IFACEMETHOD_(unsigned long, Release)();
+  IFACEMETHOD(QueryInterface)(IID const &riid, void **ppvObject);
+
+ private:
+  struct Mapping {
+    IDWriteFont *font;
+    float scale;
+  };
+
+  /* the format a table belongs to; tables are found by its hash and the
+   * format compared, so lookups do not build a string per call */
+  struct Format {
+    std::wstring family;
+    std::wstring locale;
+    DWRITE_FONT_WEIGHT weight;
+    DWRITE_FONT_STYLE style;
+    DWRITE_FONT_STRETCH stretch;
+  };
+
+  struct Table {
+    Format format;
+    std::vector<Mapping> fonts;
+    std::unordered_map<UINT32, size_t> codepoints;
+    uint64_t last_used = 0;
+  };
+
+  static size_t TableBytes(const Table &table);
+  static void ReleaseTable(Table &table);
+
+  CachedFontFallback(IDWriteFontFallback *pSystemFallback);
+  ~CachedFontFallback();
+
+  size_t AddMapping(Table &table, IDWriteFont *font, float scale);
+
+  static CachedFontFallback *instance;
+
+  unsigned long cRefCount_;
+  IDWriteFontFallback *pSystemFallback;
+
+  std::mutex mutex;
+  std::unordered_map<uint64_t, Table> tables;
+  uint64_t use_counter = 0;
+};
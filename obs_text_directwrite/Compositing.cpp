@@ -0,0 +1,372 @@
+#include "Compositing.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+    defined(__i386__)
+#define COMPOSITE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define COMPOSITE_NEON
+#include <arm_neon.h>
+#endif
+
+/* x / 255 rounded to nearest, exact for x <= 255 * 255 */
+static inline uint32_t div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+/* every channel of a pixel times a 0-255 factor */
+static inline uint32_t scale_pixel(uint32_t p, uint32_t factor) {
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8)
+    out |= div255(((p >> shift) & 0xFF) * factor) << shift;
+  return out;
+}
+
+uint32_t premultiply_color(uint32_t rgb, uint32_t opacity) {
+  uint32_t a = (opacity * 255 + 50) / 100;
+  uint32_t r = div255(((rgb >> 16) & 0xFF) * a);
+  uint32_t g = div255(((rgb >> 8) & 0xFF) * a);
+  uint32_t b = div255((rgb & 0xFF) * a);
+  return b | (g << 8) | (r << 16) | (a << 24);
+}
+
+static void fill_span_scalar(uint32_t *dst, size_t count, uint32_t color) {
+  for (size_t i = 0; i < count; i++) dst[i] = color;
+}
+
+static void coverage_to_bgra_scalar(uint32_t *dst, const uint8_t *coverage,
+                                    size_t count, uint32_t color) {
+  for (size_t i = 0; i < count; i++) dst[i] = scale_pixel(color, coverage[i]);
+}
+
+static void composite_over_solid_scalar(uint32_t *dst, const uint32_t *src,
+                                        size_t count, uint32_t bk) {
+  for (size_t i = 0; i < count; i++) {
+    uint32_t s = src[i];
+    uint32_t inv = 255 - (s >> 24);
+    uint32_t out = 0;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+      uint32_t c = ((s >> shift) & 0xFF) + div255(((bk >> shift) & 0xFF) * inv);
+      out |= (c > 255 ? 255 : c) << shift;
+    }
+    dst[i] = out;
+  }
+}
+
+static void scale_opacity_scalar(uint32_t *dst, const uint32_t *src,
+                                 size_t count, uint32_t alpha) {
+  for (size_t i = 0; i < count; i++) dst[i] = scale_pixel(src[i], alpha);
+}
+
+#ifdef COMPOSITE_X86
+
+/* a * b / 255 rounded, in 16-bit lanes holding bytes */
+static inline __m128i mul255_sse2(__m128i a, __m128i b) {
+  __m128i x = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/* two pixels widened to 16-bit lanes, with each alpha broadcast */
+static inline __m128i over_lanes_sse2(__m128i s, __m128i bk) {
+  __m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+  a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+  return _mm_add_epi16(
+      s, mul255_sse2(bk, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+}
+
+static void fill_span_sse2(uint32_t *dst, size_t count, uint32_t color) {
+  __m128i c = _mm_set1_epi32((int)color);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i *)(dst + i), c);
+  fill_span_scalar(dst + i, count - i, color);
+}
+
+static void coverage_to_bgra_sse2(uint32_t *dst, const uint8_t *coverage,
+                                  size_t count, uint32_t color) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    /* four coverage bytes, each repeated over its pixel's channels */
+    int32_t bytes;
+    memcpy(&bytes, coverage + i, sizeof(bytes));
+    __m128i c = _mm_cvtsi32_si128(bytes);
+    c = _mm_unpacklo_epi8(c, c);
+    c = _mm_unpacklo_epi16(c, c);
+
+    __m128i lo = mul255_sse2(_mm_unpacklo_epi8(c, zero), color16);
+    __m128i hi = mul255_sse2(_mm_unpackhi_epi8(c, zero), color16);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+  coverage_to_bgra_scalar(dst + i, coverage + i, count - i, color);
+}
+
+static void composite_over_solid_sse2(uint32_t *dst, const uint32_t *src,
+                                      size_t count, uint32_t bk) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i bk16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)bk), zero);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i lo = over_lanes_sse2(_mm_unpacklo_epi8(s, zero), bk16);
+    __m128i hi = over_lanes_sse2(_mm_unpackhi_epi8(s, zero), bk16);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+  composite_over_solid_scalar(dst + i, src + i, count - i, bk);
+}
+
+static void scale_opacity_sse2(uint32_t *dst, const uint32_t *src,
+                               size_t count, uint32_t alpha) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i alpha16 = _mm_set1_epi16((short)alpha);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i lo = mul255_sse2(_mm_unpacklo_epi8(s, zero), alpha16);
+    __m128i hi = mul255_sse2(_mm_unpackhi_epi8(s, zero), alpha16);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+  scale_opacity_scalar(dst + i, src + i, count - i, alpha);
+}
+
+/* MSVC compiles intrinsics for any target; GCC and clang, clang-cl
+ * included, need the function marked */
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+TARGET_AVX2
+static inline __m256i mul255_avx2(__m256i a, __m256i b) {
+  __m256i x =
+      _mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+TARGET_AVX2
+static inline __m256i over_lanes_avx2(__m256i s, __m256i bk) {
+  __m256i a = _mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+  a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+  return _mm256_add_epi16(
+      s, mul255_avx2(bk, _mm256_sub_epi16(_mm256_set1_epi16(255), a)));
+}
+
+TARGET_AVX2
+static void fill_span_avx2(uint32_t *dst, size_t count, uint32_t color) {
+  __m256i c = _mm256_set1_epi32((int)color);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i *)(dst + i), c);
+  fill_span_sse2(dst + i, count - i, color);
+}
+
+TARGET_AVX2
+static void coverage_to_bgra_avx2(uint32_t *dst, const uint8_t *coverage,
+                                  size_t count, uint32_t color) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i color16 = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero);
+  __m256i spread = _mm256_set1_epi32(0x01010101);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    /* eight coverage bytes, each repeated over its pixel's channels */
+    __m128i bytes = _mm_loadl_epi64((const __m128i *)(coverage + i));
+    __m256i c = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(bytes), spread);
+
+    __m256i lo = mul255_avx2(_mm256_unpacklo_epi8(c, zero), color16);
+    __m256i hi = mul255_avx2(_mm256_unpackhi_epi8(c, zero), color16);
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+  }
+  coverage_to_bgra_sse2(dst + i, coverage + i, count - i, color);
+}
+
+TARGET_AVX2
+static void composite_over_solid_avx2(uint32_t *dst, const uint32_t *src,
+                                      size_t count, uint32_t bk) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i bk16 = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)bk), zero);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+    __m256i lo = over_lanes_avx2(_mm256_unpacklo_epi8(s, zero), bk16);
+    __m256i hi = over_lanes_avx2(_mm256_unpackhi_epi8(s, zero), bk16);
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+  }
+  composite_over_solid_sse2(dst + i, src + i, count - i, bk);
+}
+
+TARGET_AVX2
+static void scale_opacity_avx2(uint32_t *dst, const uint32_t *src,
+                               size_t count, uint32_t alpha) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i alpha16 = _mm256_set1_epi16((short)alpha);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+    __m256i lo = mul255_avx2(_mm256_unpacklo_epi8(s, zero), alpha16);
+    __m256i hi = mul255_avx2(_mm256_unpackhi_epi8(s, zero), alpha16);
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+  }
+  scale_opacity_sse2(dst + i, src + i, count - i, alpha);
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+#ifdef COMPOSITE_NEON
+
+/* a * b / 255 rounded for eight bytes */
+static inline uint8x8_t mul255_neon(uint8x8_t a, uint8x8_t b) {
+  uint16x8_t x = vaddq_u16(vmull_u8(a, b), vdupq_n_u16(128));
+  return vmovn_u16(vshrq_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8));
+}
+
+static inline uint8x8_t over_channel_neon(uint8x8_t s, uint8x8_t bk,
+                                          uint8x8_t inv) {
+  return vqadd_u8(s, mul255_neon(bk, inv));
+}
+
+static void fill_span_neon(uint32_t *dst, size_t count, uint32_t color) {
+  uint32x4_t c = vdupq_n_u32(color);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) vst1q_u32(dst + i, c);
+  fill_span_scalar(dst + i, count - i, color);
+}
+
+static void coverage_to_bgra_neon(uint32_t *dst, const uint8_t *coverage,
+                                  size_t count, uint32_t color) {
+  uint8x8_t color_b = vdup_n_u8(color & 0xFF);
+  uint8x8_t color_g = vdup_n_u8((color >> 8) & 0xFF);
+  uint8x8_t color_r = vdup_n_u8((color >> 16) & 0xFF);
+  uint8x8_t color_a = vdup_n_u8(color >> 24);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint8x8_t c = vld1_u8(coverage + i);
+    uint8x8x4_t out;
+    out.val[0] = mul255_neon(color_b, c);
+    out.val[1] = mul255_neon(color_g, c);
+    out.val[2] = mul255_neon(color_r, c);
+    out.val[3] = mul255_neon(color_a, c);
+    vst4_u8((uint8_t *)(dst + i), out);
+  }
+  coverage_to_bgra_scalar(dst + i, coverage + i, count - i, color);
+}
+
+static void composite_over_solid_neon(uint32_t *dst, const uint32_t *src,
+                                      size_t count, uint32_t bk) {
+  uint8x8_t bk_b = vdup_n_u8(bk & 0xFF);
+  uint8x8_t bk_g = vdup_n_u8((bk >> 8) & 0xFF);
+  uint8x8_t bk_r = vdup_n_u8((bk >> 16) & 0xFF);
+  uint8x8_t bk_a = vdup_n_u8(bk >> 24);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t s = vld4_u8((const uint8_t *)(src + i));
+    uint8x8_t inv = vsub_u8(vdup_n_u8(255), s.val[3]);
+    s.val[0] = over_channel_neon(s.val[0], bk_b, inv);
+    s.val[1] = over_channel_neon(s.val[1], bk_g, inv);
+    s.val[2] = over_channel_neon(s.val[2], bk_r, inv);
+    s.val[3] = over_channel_neon(s.val[3], bk_a, inv);
+    vst4_u8((uint8_t *)(dst + i), s);
+  }
+  composite_over_solid_scalar(dst + i, src + i, count - i, bk);
+}
+
+static void scale_opacity_neon(uint32_t *dst, const uint32_t *src,
+                               size_t count, uint32_t alpha) {
+  uint8x8_t a = vdup_n_u8((uint8_t)alpha);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    uint8x8x4_t s = vld4_u8((const uint8_t *)(src + i));
+    for (int c = 0; c < 4; c++) s.val[c] = mul255_neon(s.val[c], a);
+    vst4_u8((uint8_t *)(dst + i), s);
+  }
+  scale_opacity_scalar(dst + i, src + i, count - i, alpha);
+}
+
+#endif
+
+static const CompositeKernels kernel_sets[] = {
+    {"scalar", fill_span_scalar, coverage_to_bgra_scalar,
+     composite_over_solid_scalar, scale_opacity_scalar},
+#if defined(COMPOSITE_X86)
+    {"sse2", fill_span_sse2, coverage_to_bgra_sse2, composite_over_solid_sse2,
+     scale_opacity_sse2},
+    {"avx2", fill_span_avx2, coverage_to_bgra_avx2, composite_over_solid_avx2,
+     scale_opacity_avx2},
+#elif defined(COMPOSITE_NEON)
+    {"neon", fill_span_neon, coverage_to_bgra_neon, composite_over_solid_neon,
+     scale_opacity_neon},
+#endif
+};
+
+size_t composite_kernel_sets(const CompositeKernels **sets) {
+  size_t count = sizeof(kernel_sets) / sizeof(kernel_sets[0]);
+#ifdef COMPOSITE_X86
+  if (!cpu_has_avx2()) count--;
+#endif
+  *sets = kernel_sets;
+  return count;
+}
+
+static const CompositeKernels &kernels() {
+  static const CompositeKernels *best = []() {
+    const CompositeKernels *sets;
+    size_t count = composite_kernel_sets(&sets);
+    return &sets[count - 1];
+  }();
+  return *best;
+}
+
+void fill_span(uint32_t *dst, size_t count, uint32_t color) {
+  kernels().fill_span(dst, count, color);
+}
+
+void coverage_to_bgra(uint32_t *dst, const uint8_t *coverage, size_t count,
+                      uint32_t color) {
+  kernels().coverage_to_bgra(dst, coverage, count, color);
+}
+
+void composite_over_solid(uint32_t *dst, const uint32_t *src, size_t count,
+                          uint32_t bk) {
+  kernels().composite_over_solid(dst, src, count, bk);
+}
+
+void scale_opacity(uint32_t *dst, const uint32_t *src, size_t count,
+                   uint32_t alpha) {
+  kernels().scale_opacity(dst, src, count, alpha);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Pixel kernels for premultiplied BGRA rows.
+ *
+ * Every kernel has a scalar reference; the vector versions (SSE2, AVX2 and
+ * NEON) use the same integer arithmetic and produce identical bytes, which
+ * tools/obs_text_kernels.cpp checks for every version the CPU can run. The
+ * widest version the CPU supports is picked once on first use. */
+
+/* premultiplied BGRA of a color given as 0xRRGGBB and an opacity 0-100 */
+uint32_t premultiply_color(uint32_t rgb, uint32_t opacity);
+
+/* dst = color, for count pixels */
+void fill_span(uint32_t *dst, size_t count, uint32_t color);
+
+/* dst = color scaled by each coverage byte; color is premultiplied */
+void coverage_to_bgra(uint32_t *dst, const uint8_t *coverage, size_t count,
+                      uint32_t color);
+
+/* dst = src over bk, for count pixels; bk is premultiplied */
+void composite_over_solid(uint32_t *dst, const uint32_t *src, size_t count,
+                          uint32_t bk);
+
+/* dst = src with every channel scaled by alpha 0-255 */
+void scale_opacity(uint32_t *dst, const uint32_t *src, size_t count,
+                   uint32_t alpha);
+
+/* one version of every kernel */
+struct CompositeKernels {
+  const char *name;
+  void (*fill_span)(uint32_t *dst, size_t count, uint32_t color);
+  void (*coverage_to_bgra)(uint32_t *dst, const uint8_t *coverage,
+                           size_t count, uint32_t color);
+  void (*composite_over_solid)(uint32_t *dst, const uint32_t *src,
+                               size_t count, uint32_t bk);
+  void (*scale_opacity)(uint32_t *dst, const uint32_t *src, size_t count,
+                        uint32_t alpha);
+};
+
+/* the versions this CPU can run, the scalar reference first and the one
+ * in use last */
+size_t composite_kernel_sets(const CompositeKernels **sets);
@@ -0,0 +1,120 @@
+#include "ContentHash.h"
+
+#include <string.h>
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+/* unaligned little-endian loads, the plugin only targets little-endian */
+static inline uint64_t read64(const uint8_t *p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  acc = rotl(acc, 31);
+  return acc * PRIME64_1;
+}
+
+static inline uint64_t merge(uint64_t hash, uint64_t acc) {
+  hash ^= xxh_round(0, acc);
+  return hash * PRIME64_1 + PRIME64_4;
+}
+
+ContentHash::ContentHash(uint64_t seed_) : seed(seed_) {
+  acc[0] = seed + PRIME64_1 + PRIME64_2;
+  acc[1] = seed + PRIME64_2;
+  acc[2] = seed;
+  acc[3] = seed - PRIME64_1;
+}
+
+void ContentHash::Update(const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  const uint8_t *end = p + len;
+  total += len;
+
+  if (buffered + len < sizeof(buffer)) {
+    memcpy(buffer + buffered, p, len);
+    buffered += len;
+    return;
+  }
+
+  if (buffered) {
+    size_t fill = sizeof(buffer) - buffered;
+    memcpy(buffer + buffered, p, fill);
+    p += fill;
+    for (int i = 0; i < 4; i++)
+      acc[i] = xxh_round(acc[i], read64(buffer + i * 8));
+    buffered = 0;
+  }
+
+  while (end - p >= 32) {
+    acc[0] = xxh_round(acc[0], read64(p));
+    acc[1] = xxh_round(acc[1], read64(p + 8));
+    acc[2] = xxh_round(acc[2], read64(p + 16));
+    acc[3] = xxh_round(acc[3], read64(p + 24));
+    p += 32;
+  }
+
+  buffered = end - p;
+  memcpy(buffer, p, buffered);
+}
+
+uint64_t ContentHash::Digest() const {
+  uint64_t hash;
+
+  if (total >= 32) {
+    hash = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) +
+           rotl(acc[3], 18);
+    for (int i = 0; i < 4; i++) hash = merge(hash, acc[i]);
+  } else {
+    hash = seed + PRIME64_5;
+  }
+
+  hash += total;
+
+  const uint8_t *p = buffer;
+  const uint8_t *end = buffer + buffered;
+
+  for (; end - p >= 8; p += 8) {
+    hash ^= xxh_round(0, read64(p));
+    hash = rotl(hash, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (end - p >= 4) {
+    hash ^= read32(p) * PRIME64_1;
+    hash = rotl(hash, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    hash ^= *p * PRIME64_5;
+    hash = rotl(hash, 11) * PRIME64_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+uint64_t ContentHash::Hash(const void *data, size_t len, uint64_t seed) {
+  ContentHash hash(seed);
+  hash.Update(data, len);
+  return hash.Digest();
+}
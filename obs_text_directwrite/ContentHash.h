@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Streaming XXH64.
+ *
+ * Used to tell whether file content or render inputs changed since they
+ * were last seen; it is several times faster than byte-wise hashes on
+ * long text and produces the reference XXH64 values. */
+class ContentHash {
+ public:
+  explicit ContentHash(uint64_t seed = 0);
+
+  void Update(const void *data, size_t len);
+  uint64_t Digest() const;
+
+  static uint64_t Hash(const void *data, size_t len, uint64_t seed = 0);
+
+ private:
+  uint64_t seed;
+  uint64_t acc[4];
+  uint64_t total = 0;
+  uint8_t buffer[32];
+  size_t buffered = 0;
+};
@@ -1,33 +1,46 @@
 #include "CustomTextRenderer.h"
 
-CustomTextRenderer::CustomTextRenderer(
-    ID2D1Factory* pD2DFactory_, IDWriteFactory4* pDWriteFactory_,
-    ID2D1RenderTarget* pRT_, ID2D1Brush* pOutlineBrush_,
-    ID2D1Brush* pFillBrush_, const float& Outline_size_, const bool& vertical_)
-    : cRefCount_(0),
+#include "GlyphRunCache.h"
+
+#define RENDERER_TEMPLATE template <bool Outline, bool Vertical>
+#define RENDERER CustomTextRenderer<Outline, Vertical>
+
+RENDERER_TEMPLATE
+RENDERER::CustomTextRenderer(ID2D1Factory* pD2DFactory_,
+                             IDWriteFactory4* pDWriteFactory_,
+                             ID2D1RenderTarget* pRT_,
+                             ID2D1Brush* pOutlineBrush_,
+                             ID2D1Brush* pFillBrush_,
+                             const float& Outline_size_,
+                             GlyphRunCache* pRunCache_)
+    : cRefCount_(1),
       pD2DFactory(pD2DFactory_),
       pDWriteFactory(pDWriteFactory_),
+      pAnalyzer(nullptr),
       pRT(pRT_),
       pFillBrush(pFillBrush_),
-      Outline_size(Outline_size_),
-      vertical(vertical_) {
+      pRunCache(pRunCache_),
+      Outline_size(Outline_size_) {
   pD2DFactory->AddRef();
   pDWriteFactory->AddRef();
   pRT->AddRef();
   pFillBrush->AddRef();
 
-  if (pOutlineBrush_) {
+  if (Outline && pOutlineBrush_) {
     pOutlineBrush = pOutlineBrush_;
     pOutlineBrush->AddRef();
   }
 
-  IDWriteTextAnalyzer* analyzer;
-  pDWriteFactory->CreateTextAnalyzer(&analyzer);
-  analyzer->QueryInterface<IDWriteTextAnalyzer2>(&pAnalyzer);
-  SafeRelease(&analyzer);
+  if (Vertical) {
+    IDWriteTextAnalyzer* analyzer;
+    pDWriteFactory->CreateTextAnalyzer(&analyzer);
+    analyzer->QueryInterface<IDWriteTextAnalyzer2>(&pAnalyzer);
+    SafeRelease(&analyzer);
+  }
 }
 
-CustomTextRenderer::~CustomTextRenderer() {
+RENDERER_TEMPLATE
+RENDERER::~CustomTextRenderer() {
   SafeRelease(&pD2DFactory);
   SafeRelease(&pDWriteFactory);
   SafeRelease(&pAnalyzer);
@@ -36,27 +49,13 @@ CustomTextRenderer::~CustomTextRenderer() {
   SafeRelease(&pFillBrush);
 }
 
-HRESULT CustomTextRenderer::DrawGlyphRun(const DWRITE_GLYPH_RUN* glyphRun,
-                                         const D2D1::Matrix3x2F& matrix,
-                                         ID2D1Brush* fillBrush, ID2D1Brush* outlineBrush) {
+RENDERER_TEMPLATE
+HRESULT RENDERER::DrawGlyphRun(const DWRITE_GLYPH_RUN* glyphRun,
+                               const D2D1::Matrix3x2F& matrix,
+                               ID2D1Brush* fillBrush,
+                               ID2D1Brush* outlineBrush) {
   ID2D1PathGeometry* pPathGeometry = nullptr;
-  HRESULT hr = pD2DFactory->CreatePathGeometry(&pPathGeometry);
-
-  ID2D1GeometrySink* pSink = nullptr;
-  if (SUCCEEDED(hr)) {
-    hr = pPathGeometry->Open(&pSink);
-  }
-
-  if (SUCCEEDED(hr)) {
-    hr = glyphRun->fontFace->GetGlyphRunOutline(
-        glyphRun->fontEmSize, glyphRun->glyphIndices, glyphRun->glyphAdvances,
-        glyphRun->glyphOffsets, glyphRun->glyphCount, glyphRun->isSideways,
-        glyphRun->bidiLevel & 1, pSink);
-  }
-
-  if (SUCCEEDED(hr)) {
-    hr = pSink->Close();
-  }
+  HRESULT hr = pRunCache->Get(pD2DFactory, glyphRun, &pPathGeometry);
 
   ID2D1TransformedGeometry* pTransformedGeometry = nullptr;
   if (SUCCEEDED(hr)) {
@@ -65,7 +64,7 @@ HRESULT CustomTextRenderer::DrawGlyphRun(const DWRITE_GLYPH_RUN* glyphRun,
   }
 
   if (SUCCEEDED(hr)) {
-    if (outlineBrush) {
+    if (Outline && outlineBrush) {
       pRT->DrawGeometry(pTransformedGeometry, outlineBrush, Outline_size);
     }
 
@@ -73,13 +72,30 @@ HRESULT CustomTextRenderer::DrawGlyphRun(const DWRITE_GLYPH_RUN* glyphRun,
   }
 
   SafeRelease(&pPathGeometry);
-  SafeRelease(&pSink);
   SafeRelease(&pTransformedGeometry);
 
   return hr;
 }
 
-IFACEMETHODIMP CustomTextRenderer::DrawGlyphRun(
+/* horizontal text never rotates glyphs, the run is only moved to its
+ * baseline origin */
+RENDERER_TEMPLATE
+D2D1::Matrix3x2F RENDERER::RunTransform(
+    FLOAT baselineOriginX, FLOAT baselineOriginY,
+    DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle, BOOL isSideways) {
+  if (!Vertical)
+    return D2D1::Matrix3x2F::Translation(baselineOriginX, baselineOriginY);
+
+  D2D1::Matrix3x2F matrix{};
+  pAnalyzer->GetGlyphOrientationTransform(orientationAngle, isSideways,
+                                          (DWRITE_MATRIX*)&matrix);
+  matrix.dx = baselineOriginX;
+  matrix.dy = baselineOriginY;
+  return matrix;
+}
+
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawGlyphRun(
     __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
     FLOAT baselineOriginY, DWRITE_MEASURING_MODE measuringMode,
     __in DWRITE_GLYPH_RUN const* glyphRun,
@@ -90,90 +106,64 @@ IFACEMETHODIMP CustomTextRenderer::DrawGlyphRun(
                       glyphRun, glyphRunDescription, clientDrawingEffect);
 }
 
-IFACEMETHODIMP CustomTextRenderer::DrawGlyphRun(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawGlyphRun(
     __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
     FLOAT baselineOriginY, DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle,
     DWRITE_MEASURING_MODE measuringMode, __in DWRITE_GLYPH_RUN const* glyphRun,
     __in DWRITE_GLYPH_RUN_DESCRIPTION const* glyphRunDescription,
     __maybenull IUnknown* clientDrawingEffect) {
-  HRESULT hr = S_OK;
-
-  bool isColor = false;
-  IDWriteColorGlyphRunEnumerator1* colorLayer;
-
-  if (SUCCEEDED(pDWriteFactory->TranslateColorGlyphRun(
-          {0, 0}, glyphRun, glyphRunDescription,
-          DWRITE_GLYPH_IMAGE_FORMATS_TRUETYPE | DWRITE_GLYPH_IMAGE_FORMATS_CFF |
-              DWRITE_GLYPH_IMAGE_FORMATS_COLR,
-          measuringMode, nullptr, 0, &colorLayer))) {
-    isColor = true;
-  }
-
-  if (isColor) {
-    BOOL hasRun;
-    const DWRITE_COLOR_GLYPH_RUN1* colorRun;
-    ID2D1SolidColorBrush* temp_brush;
-    pRT->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), &temp_brush);
-    while (SUCCEEDED(colorLayer->MoveNext(&hasRun)) && hasRun) {
-      hr = colorLayer->GetCurrentRun(&colorRun);
-      if (FAILED(hr)) {
-        break;
-      }
-      ID2D1Brush* brush = pFillBrush;
-      if (colorRun->paletteIndex != 0xFFFF) {
-        temp_brush->SetColor(colorRun->runColor);
-        brush = temp_brush;
+  const D2D1::Matrix3x2F matrix = RunTransform(
+      baselineOriginX, baselineOriginY, orientationAngle, glyphRun->isSideways);
+
+  if (pRunCache->IsColorFont(glyphRun->fontFace)) {
+    IDWriteColorGlyphRunEnumerator1* colorLayer = nullptr;
+    if (SUCCEEDED(pDWriteFactory->TranslateColorGlyphRun(
+            {0, 0}, glyphRun, glyphRunDescription,
+            DWRITE_GLYPH_IMAGE_FORMATS_TRUETYPE |
+                DWRITE_GLYPH_IMAGE_FORMATS_CFF |
+                DWRITE_GLYPH_IMAGE_FORMATS_COLR,
+            measuringMode, nullptr, 0, &colorLayer))) {
+      HRESULT hr = S_OK;
+      BOOL hasRun;
+      const DWRITE_COLOR_GLYPH_RUN1* colorRun;
+      ID2D1SolidColorBrush* temp_brush = nullptr;
+      pRT->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black),
+                                 &temp_brush);
+      while (SUCCEEDED(colorLayer->MoveNext(&hasRun)) && hasRun) {
+        hr = colorLayer->GetCurrentRun(&colorRun);
+        if (FAILED(hr)) {
+          break;
+        }
+        ID2D1Brush* brush = pFillBrush;
+        if (colorRun->paletteIndex != 0xFFFF) {
+          temp_brush->SetColor(colorRun->runColor);
+          brush = temp_brush;
+        }
+        const D2D1::Matrix3x2F origin = D2D1::Matrix3x2F::Translation(
+            colorRun->baselineOriginX, colorRun->baselineOriginY);
+
+        hr = DrawGlyphRun(&colorRun->glyphRun, origin * matrix, brush, nullptr);
       }
-      const D2D1::Matrix3x2F origin =
-          D2D1::Matrix3x2F(1.f, 0.f, 0.f, 1.f, colorRun->baselineOriginX,
-                           colorRun->baselineOriginY);
-
-      D2D1::Matrix3x2F matrix{};
-      pAnalyzer->GetGlyphOrientationTransform(orientationAngle,
-                                              colorRun->glyphRun.isSideways,
-                                              (DWRITE_MATRIX*)&matrix);
-      matrix.dx = baselineOriginX;
-      matrix.dy = baselineOriginY;
-
-      hr = DrawGlyphRun(&colorRun->glyphRun, origin * matrix, brush, nullptr);
+      SafeRelease(&temp_brush);
+      SafeRelease(&colorLayer);
+      return hr;
     }
-    SafeRelease(&temp_brush);
-  } else {
-    D2D1::Matrix3x2F matrix{};
-    pAnalyzer->GetGlyphOrientationTransform(
-        orientationAngle, glyphRun->isSideways, (DWRITE_MATRIX*)&matrix);
-    matrix.dx = baselineOriginX;
-    matrix.dy = baselineOriginY;
-    hr = DrawGlyphRun(glyphRun, matrix, pFillBrush, pOutlineBrush);
   }
 
-  return hr;
-}
-
-IFACEMETHODIMP CustomTextRenderer::DrawUnderline(
-    __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
-    FLOAT baselineOriginY, __in DWRITE_UNDERLINE const* underline,
-    __maybenull IUnknown* clientDrawingEffect) {
-  return DrawUnderline(clientDrawingContext, baselineOriginX, baselineOriginY,
-                       DWRITE_GLYPH_ORIENTATION_ANGLE_0_DEGREES, underline,
-                       clientDrawingEffect);
+  return DrawGlyphRun(glyphRun, matrix, pFillBrush, pOutlineBrush);
 }
 
-IFACEMETHODIMP CustomTextRenderer::DrawUnderline(
-    __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
-    FLOAT baselineOriginY, DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle,
-    __in DWRITE_UNDERLINE const* underline,
-    __maybenull IUnknown* clientDrawingEffect) {
-  D2D1_RECT_F rect = D2D1::RectF(0.f, underline->offset, underline->width,
-                                 underline->offset + underline->thickness);
-
+RENDERER_TEMPLATE
+HRESULT RENDERER::DrawLine(const D2D1_RECT_F& rect, FLOAT baselineOriginX,
+                           FLOAT baselineOriginY,
+                           DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle) {
   ID2D1RectangleGeometry* pRectangleGeometry = nullptr;
-
   HRESULT hr = pD2DFactory->CreateRectangleGeometry(&rect, &pRectangleGeometry);
 
-  const D2D1::Matrix3x2F matrix =
-      D2D1::Matrix3x2F(1.f, 0.f, 0.f, 1.f, baselineOriginX, baselineOriginY);
-  const auto& result = matrix * rotations[orientationAngle];
+  D2D1::Matrix3x2F result =
+      D2D1::Matrix3x2F::Translation(baselineOriginX, baselineOriginY);
+  if (Vertical) result = result * rotations[orientationAngle];
 
   ID2D1TransformedGeometry* pTransformedGeometry = nullptr;
   if (SUCCEEDED(hr)) {
@@ -182,7 +172,7 @@ IFACEMETHODIMP CustomTextRenderer::DrawUnderline(
   }
 
   if (SUCCEEDED(hr)) {
-    if (pOutlineBrush)
+    if (Outline && pOutlineBrush)
       pRT->DrawGeometry(pTransformedGeometry, pOutlineBrush, Outline_size);
 
     pRT->FillGeometry(pTransformedGeometry, pFillBrush);
@@ -194,15 +184,41 @@ IFACEMETHODIMP CustomTextRenderer::DrawUnderline(
   return S_OK;
 }
 
-IFACEMETHODIMP CustomTextRenderer::DrawStrikethrough(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawUnderline(
+    __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
+    FLOAT baselineOriginY, __in DWRITE_UNDERLINE const* underline,
+    __maybenull IUnknown* clientDrawingEffect) {
+  return DrawUnderline(clientDrawingContext, baselineOriginX, baselineOriginY,
+                       DWRITE_GLYPH_ORIENTATION_ANGLE_0_DEGREES, underline,
+                       clientDrawingEffect);
+}
+
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawUnderline(
+    __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
+    FLOAT baselineOriginY, DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle,
+    __in DWRITE_UNDERLINE const* underline,
+    __maybenull IUnknown* clientDrawingEffect) {
+  D2D1_RECT_F rect = D2D1::RectF(0.f, underline->offset, underline->width,
+                                 underline->offset + underline->thickness);
+
+  return DrawLine(rect, baselineOriginX, baselineOriginY, orientationAngle);
+}
+
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawStrikethrough(
     __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
     FLOAT baselineOriginY, __in DWRITE_STRIKETHROUGH const* strikethrough,
     __maybenull IUnknown* clientDrawingEffect) {
   return DrawStrikethrough(clientDrawingContext, baselineOriginX,
-                           baselineOriginY, strikethrough, clientDrawingEffect);
+                           baselineOriginY,
+                           DWRITE_GLYPH_ORIENTATION_ANGLE_0_DEGREES,
+                           strikethrough, clientDrawingEffect);
 }
 
-IFACEMETHODIMP CustomTextRenderer::DrawStrikethrough(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawStrikethrough(
     __maybenull void* clientDrawingContext, FLOAT baselineOriginX,
     FLOAT baselineOriginY, DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle,
     __in DWRITE_STRIKETHROUGH const* strikethrough,
@@ -211,39 +227,19 @@ IFACEMETHODIMP CustomTextRenderer::DrawStrikethrough(
       D2D1::RectF(0.f, strikethrough->offset, strikethrough->width,
                   strikethrough->offset + strikethrough->thickness);
 
-  ID2D1RectangleGeometry* pRectangleGeometry = nullptr;
-  HRESULT hr = pD2DFactory->CreateRectangleGeometry(&rect, &pRectangleGeometry);
-
-  const D2D1::Matrix3x2F matrix =
-      D2D1::Matrix3x2F(1.f, 0.f, 0.f, 1.f, baselineOriginX, baselineOriginY);
-  const auto& result = matrix * rotations[orientationAngle];
-
-  ID2D1TransformedGeometry* pTransformedGeometry = nullptr;
-  if (SUCCEEDED(hr)) {
-    hr = pD2DFactory->CreateTransformedGeometry(pRectangleGeometry, &result,
-                                                &pTransformedGeometry);
-  }
-  if (SUCCEEDED(hr)) {
-    if (pOutlineBrush)
-      pRT->DrawGeometry(pTransformedGeometry, pOutlineBrush, Outline_size);
-
-    pRT->FillGeometry(pTransformedGeometry, pFillBrush);
-  }
-
-  SafeRelease(&pRectangleGeometry);
-  SafeRelease(&pTransformedGeometry);
-
-  return S_OK;
+  return DrawLine(rect, baselineOriginX, baselineOriginY, orientationAngle);
 }
 
-IFACEMETHODIMP CustomTextRenderer::DrawInlineObject(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawInlineObject(
     __maybenull void* clientDrawingContext, FLOAT originX, FLOAT originY,
     IDWriteInlineObject* inlineObject, BOOL isSideways, BOOL isRightToLeft,
     __maybenull IUnknown* clientDrawingEffect) {
   return E_NOTIMPL;
 }
 
-IFACEMETHODIMP CustomTextRenderer::DrawInlineObject(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::DrawInlineObject(
     __maybenull void* clientDrawingContext, FLOAT originX, FLOAT originY,
     DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle,
     __in IDWriteInlineObject* inlineObject, BOOL isSideways, BOOL isRightToLeft,
@@ -251,30 +247,35 @@ IFACEMETHODIMP CustomTextRenderer::DrawInlineObject(
   return E_NOTIMPL;
 }
 
-IFACEMETHODIMP CustomTextRenderer::IsPixelSnappingDisabled(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::IsPixelSnappingDisabled(
     __maybenull void* clientDrawingContext, __out BOOL* isDisabled) {
   *isDisabled = FALSE;
   return S_OK;
 }
 
-IFACEMETHODIMP CustomTextRenderer::GetCurrentTransform(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::GetCurrentTransform(
     __maybenull void* clientDrawingContext, __out DWRITE_MATRIX* transform) {
   // forward the render target's transform
   pRT->GetTransform(reinterpret_cast<D2D1_MATRIX_3X2_F*>(transform));
   return S_OK;
 }
 
-IFACEMETHODIMP CustomTextRenderer::GetPixelsPerDip(
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::GetPixelsPerDip(
     __maybenull void* clientDrawingContext, __out FLOAT* pixelsPerDip) {
   *pixelsPerDip = 1.0f;
   return S_OK;
 }
 
-IFACEMETHODIMP_(unsigned long) CustomTextRenderer::AddRef() {
+RENDERER_TEMPLATE
+IFACEMETHODIMP_(unsigned long) RENDERER::AddRef() {
   return InterlockedIncrement(&cRefCount_);
 }
 
-IFACEMETHODIMP_(unsigned long) CustomTextRenderer::Release() {
+RENDERER_TEMPLATE
+IFACEMETHODIMP_(unsigned long) RENDERER::Release() {
   unsigned long newCount = InterlockedDecrement(&cRefCount_);
   if (newCount == 0) {
     delete this;
@@ -284,8 +285,8 @@ IFACEMETHODIMP_(unsigned long) CustomTextRenderer::Release() {
   return newCount;
 }
 
-IFACEMETHODIMP CustomTextRenderer::QueryInterface(IID const& riid,
-                                                  void** ppvObject) {
+RENDERER_TEMPLATE
+IFACEMETHODIMP RENDERER::QueryInterface(IID const& riid, void** ppvObject) {
   if (__uuidof(IDWriteTextRenderer1) == riid ||
       __uuidof(IDWriteTextRenderer) == riid ||
       __uuidof(IDWritePixelSnapping) == riid || __uuidof(IUnknown) == riid) {
@@ -297,3 +298,31 @@ IFACEMETHODIMP CustomTextRenderer::QueryInterface(IID const& riid,
     return E_FAIL;
   }
 }
+
+template <bool Outline>
+static IDWriteTextRenderer1* create_renderer(
+    ID2D1Factory* pD2DFactory, IDWriteFactory4* pDWriteFactory,
+    ID2D1RenderTarget* pRT, ID2D1Brush* pOutlineBrush, ID2D1Brush* pFillBrush,
+    float Outline_size, bool vertical, GlyphRunCache* pRunCache) {
+  if (vertical)
+    return new CustomTextRenderer<Outline, true>(
+        pD2DFactory, pDWriteFactory, pRT, pOutlineBrush, pFillBrush,
+        Outline_size, pRunCache);
+
+  return new CustomTextRenderer<Outline, false>(
+      pD2DFactory, pDWriteFactory, pRT, pOutlineBrush, pFillBrush,
+      Outline_size, pRunCache);
+}
+
+IDWriteTextRenderer1* CreateTextRenderer(
+    ID2D1Factory* pD2DFactory, IDWriteFactory4* pDWriteFactory,
+    ID2D1RenderTarget* pRT, ID2D1Brush* pOutlineBrush, ID2D1Brush* pFillBrush,
+    float Outline_size, bool vertical, GlyphRunCache* pRunCache) {
+  if (pOutlineBrush)
+    return create_renderer<true>(pD2DFactory, pDWriteFactory, pRT,
+                                 pOutlineBrush, pFillBrush, Outline_size,
+                                 vertical, pRunCache);
+
+  return create_renderer<false>(pD2DFactory, pDWriteFactory, pRT, nullptr,
+                                pFillBrush, Outline_size, vertical, pRunCache);
+}
@@ -12,6 +12,8 @@
 #include <array>
 #include <exception>
 
+class GlyphRunCache;
+
 template <class T>
 void SafeRelease(T** ppT) {
   if (*ppT) {
@@ -20,12 +22,22 @@ void SafeRelease(T** ppT) {
   }
 }
 
+/* Draws glyph runs as geometry so they can be outlined.
+ *
+ * The features that change how a run is drawn are template parameters:
+ * Outline strokes every run and Vertical applies the glyph orientation
+ * transform. The variant is chosen once per render by CreateTextRenderer,
+ * so the draw callbacks carry no branches for features the text does not
+ * use. Color layers are only looked up for runs whose font face is a color
+ * font. Run outlines and the color font check come from the source's
+ * GlyphRunCache. */
+template <bool Outline, bool Vertical>
 class CustomTextRenderer : public IDWriteTextRenderer1 {
  public:
   CustomTextRenderer(ID2D1Factory* pD2DFactory,
                      IDWriteFactory4* pDWriteFactory, ID2D1RenderTarget* pRT,
                      ID2D1Brush* pOutlineBrush, ID2D1Brush* pFillBrush,
-                     const float& Outline_size_, const bool& vertical_);
+                     const float& Outline_size_, GlyphRunCache* pRunCache_);
 
   ~CustomTextRenderer();
 
@@ -93,18 +105,32 @@ class CustomTextRenderer : public IDWriteTextRenderer1 {
  private:
   unsigned long cRefCount_;
   float Outline_size;
-  bool vertical;
   ID2D1Factory* pD2DFactory;
   IDWriteFactory4* pDWriteFactory;
   IDWriteTextAnalyzer2* pAnalyzer;
   ID2D1RenderTarget* pRT;
   ID2D1Brush* pOutlineBrush = nullptr;
   ID2D1Brush* pFillBrush;
+  GlyphRunCache* pRunCache;
 
   std::array<D2D1::Matrix3x2F, 4> rotations = {
       D2D1::Matrix3x2F::Rotation(0.f), D2D1::Matrix3x2F::Rotation(90.f),
       D2D1::Matrix3x2F::Rotation(180.f), D2D1::Matrix3x2F::Rotation(270.f)};
 
   HRESULT DrawGlyphRun(const DWRITE_GLYPH_RUN* glyphRun,
-                       const D2D1::Matrix3x2F& matrix, ID2D1Brush* fillBrush, ID2D1Brush* outlineBrush);
+                       const D2D1::Matrix3x2F& matrix, ID2D1Brush* fillBrush,
+                       ID2D1Brush* outlineBrush);
+  HRESULT DrawLine(const D2D1_RECT_F& rect, FLOAT baselineOriginX,
+                   FLOAT baselineOriginY,
+                   DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle);
+  D2D1::Matrix3x2F RunTransform(FLOAT baselineOriginX, FLOAT baselineOriginY,
+                                DWRITE_GLYPH_ORIENTATION_ANGLE orientationAngle,
+                                BOOL isSideways);
 };
+
+/* Creates the renderer variant for the given features, holding one
+ * reference. Without an outline brush no outline is drawn. */
+IDWriteTextRenderer1* CreateTextRenderer(
+    ID2D1Factory* pD2DFactory, IDWriteFactory4* pDWriteFactory,
+    ID2D1RenderTarget* pRT, ID2D1Brush* pOutlineBrush, ID2D1Brush* pFillBrush,
+    float Outline_size, bool vertical, GlyphRunCache* pRunCache);
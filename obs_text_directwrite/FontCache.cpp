@@ -0,0 +1,224 @@
+#include "FontCache.h"
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <windows.h>
+
+#include <algorithm>
+
+#include "CustomTextRenderer.h"
+
+using namespace std;
+
+/* fonts installed while OBS runs are noticed within this long */
+#define FONT_REFRESH_INTERVAL_NS 5000000000ULL
+
+mutex FontCache::mutex;
+condition_variable FontCache::wake;
+thread FontCache::worker;
+bool FontCache::ready = false;
+bool FontCache::refresh_requested = false;
+bool FontCache::stopping = false;
+uint64_t FontCache::last_refresh = 0;
+atomic<uint32_t> FontCache::generation{0};
+IDWriteFactory *FontCache::factory = nullptr;
+IDWriteFontCollection *FontCache::collection = nullptr;
+unordered_map<wstring, wstring> FontCache::families;
+unordered_map<wstring, FontResolution> FontCache::resolved;
+unordered_set<wstring> FontCache::misses;
+
+static inline wstring to_lower(const wstring &str) {
+  wstring lower = str;
+  transform(lower.begin(), lower.end(), lower.begin(), towlower);
+  return lower;
+}
+
+/* every localized name of every family, lower-cased, to its own spelling */
+static void enumerate_families(IDWriteFontCollection *collection,
+                               unordered_map<wstring, wstring> &families) {
+  UINT32 count = collection->GetFontFamilyCount();
+  for (UINT32 i = 0; i < count; i++) {
+    IDWriteFontFamily *family = nullptr;
+    IDWriteLocalizedStrings *names = nullptr;
+
+    if (SUCCEEDED(collection->GetFontFamily(i, &family)) &&
+        SUCCEEDED(family->GetFamilyNames(&names))) {
+      /* every localized name maps to the same family */
+      UINT32 name_count = names->GetCount();
+      for (UINT32 j = 0; j < name_count; j++) {
+        UINT32 len = 0;
+        if (FAILED(names->GetStringLength(j, &len))) continue;
+
+        wstring name(len + 1, L'\0');
+        if (FAILED(names->GetString(j, &name[0], len + 1))) continue;
+        name.resize(len);
+
+        families.emplace(to_lower(name), name);
+      }
+    }
+
+    SafeRelease(&names);
+    SafeRelease(&family);
+  }
+}
+
+void FontCache::Warmup() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    if (!CreateFactory()) return;
+  }
+
+  /* the factory lives until Shutdown, which joins the worker first */
+  worker = thread(Work);
+}
+
+void FontCache::Shutdown() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (worker.joinable()) worker.join();
+
+  lock_guard<std::mutex> lock(mutex);
+  families.clear();
+  resolved.clear();
+  misses.clear();
+  SafeRelease(&collection);
+  SafeRelease(&factory);
+}
+
+bool FontCache::CreateFactory() {
+  if (factory) return true;
+
+  HRESULT hr = DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED,
+                                   __uuidof(IDWriteFactory),
+                                   reinterpret_cast<IUnknown **>(&factory));
+  return SUCCEEDED(hr);
+}
+
+/* builds the index once, then checks the system collection whenever a name
+ * missed, at most once per FONT_REFRESH_INTERVAL_NS. the collection is
+ * queried and enumerated without the lock; only the swap takes it. */
+void FontCache::Work() {
+  unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    if (ready) {
+      wake.wait(lock, []() { return stopping || refresh_requested; });
+
+      uint64_t due = last_refresh + FONT_REFRESH_INTERVAL_NS;
+      uint64_t now = os_gettime_ns();
+      if (!stopping && now < due)
+        wake.wait_for(lock, chrono::nanoseconds(due - now),
+                      []() { return stopping; });
+      if (stopping) break;
+      refresh_requested = false;
+    }
+
+    bool check_updates = ready;
+    IDWriteFontCollection *current = collection;
+    if (current) current->AddRef();
+    lock.unlock();
+
+    uint64_t start = os_gettime_ns();
+    IDWriteFontCollection *fonts = nullptr;
+    unordered_map<wstring, wstring> names;
+    bool changed = SUCCEEDED(factory->GetSystemFontCollection(
+                       &fonts, check_updates ? TRUE : FALSE)) &&
+                   fonts != current;
+    if (changed) enumerate_families(fonts, names);
+    SafeRelease(&current);
+
+    lock.lock();
+    if (changed) {
+      SafeRelease(&collection);
+      collection = fonts;
+      families.swap(names);
+      resolved.clear();
+      misses.clear();
+      generation++;
+
+      blog(LOG_INFO,
+           "[text_directwrite] %zu font family names indexed in %llu ms",
+           families.size(),
+           (unsigned long long)((os_gettime_ns() - start) / 1000000));
+    } else {
+      SafeRelease(&fonts);
+    }
+    ready = true;
+    last_refresh = os_gettime_ns();
+  }
+}
+
+bool FontCache::ResolveGdi(const wstring &face, FontResolution &result) {
+  if (face.empty() || face.size() >= LF_FACESIZE) return false;
+
+  IDWriteGdiInterop *interop = nullptr;
+  IDWriteFont *font = nullptr;
+  IDWriteFontFamily *family = nullptr;
+  IDWriteLocalizedStrings *names = nullptr;
+
+  LOGFONTW lf = {};
+  lf.lfCharSet = DEFAULT_CHARSET;
+  wcsncpy_s(lf.lfFaceName, face.c_str(), _TRUNCATE);
+
+  HRESULT hr = factory->GetGdiInterop(&interop);
+  if (SUCCEEDED(hr)) hr = interop->CreateFontFromLOGFONT(&lf, &font);
+  if (SUCCEEDED(hr)) hr = font->GetFontFamily(&family);
+  if (SUCCEEDED(hr)) hr = family->GetFamilyNames(&names);
+
+  UINT32 len = 0;
+  if (SUCCEEDED(hr)) hr = names->GetStringLength(0, &len);
+  if (SUCCEEDED(hr)) {
+    result.family.assign(len + 1, L'\0');
+    hr = names->GetString(0, &result.family[0], len + 1);
+    result.family.resize(len);
+  }
+  if (SUCCEEDED(hr)) {
+    result.weight = font->GetWeight();
+    result.style = font->GetStyle();
+    result.stretch = font->GetStretch();
+  }
+
+  SafeRelease(&names);
+  SafeRelease(&family);
+  SafeRelease(&font);
+  SafeRelease(&interop);
+
+  return SUCCEEDED(hr);
+}
+
+FontResolution FontCache::Resolve(const wstring &face) {
+  lock_guard<std::mutex> lock(mutex);
+
+  wstring key = to_lower(face);
+  auto cached = resolved.find(key);
+  if (cached != resolved.end()) return cached->second;
+
+  /* the name is handed to DirectWrite as is and falls back like it always
+   * did until the worker has the index ready or finds the font; sources
+   * resolve again when the generation moves */
+  FontResolution result;
+  result.family = face;
+  if (!ready || misses.count(key)) return result;
+
+  auto family = families.find(key);
+  if (family != families.end()) {
+    result.family = family->second;
+    resolved.emplace(key, result);
+    return result;
+  }
+  if (factory && ResolveGdi(face, result)) {
+    resolved.emplace(key, result);
+    return result;
+  }
+
+  /* unknown name, fonts may have been installed since the last check */
+  misses.insert(key);
+  refresh_requested = true;
+  wake.notify_one();
+
+  result = FontResolution();
+  result.family = face;
+  return result;
+}
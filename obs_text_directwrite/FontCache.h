@@ -0,0 +1,60 @@
+#pragma once
+
+#include <dwrite.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+struct FontResolution {
+  std::wstring family;
+  DWRITE_FONT_WEIGHT weight = DWRITE_FONT_WEIGHT_REGULAR;
+  DWRITE_FONT_STYLE style = DWRITE_FONT_STYLE_NORMAL;
+  DWRITE_FONT_STRETCH stretch = DWRITE_FONT_STRETCH_NORMAL;
+};
+
+/* Module-wide face name resolution.
+ *
+ * The system font collection is enumerated on a worker thread started at
+ * module load, outside the lock, and swapped in once complete, so neither
+ * the first text format nor any lookup waits for it. Face names coming from
+ * the font dialog are GDI names ("Arial Black", "Segoe UI Semibold") which
+ * DirectWrite does not always know as a family; those are resolved through
+ * GDI interop to a family plus weight, style and stretch. Lookups are
+ * case-insensitive and cached, misses included. A miss, or a lookup before
+ * the index is ready, returns the name unresolved and, for a miss, asks the
+ * worker to check the system collection for installed or removed fonts, at
+ * most once per FONT_REFRESH_INTERVAL_NS. Generation() changes whenever the
+ * index is rebuilt, telling callers to resolve their names again. */
+class FontCache {
+ public:
+  static void Warmup();
+  static void Shutdown();
+
+  static FontResolution Resolve(const std::wstring &face);
+  static inline uint32_t Generation() { return generation; }
+
+ private:
+  static bool CreateFactory();
+  static void Work();
+  static bool ResolveGdi(const std::wstring &face, FontResolution &result);
+
+  static std::mutex mutex;
+  static std::condition_variable wake;
+  static std::thread worker;
+  static bool ready;
+  static bool refresh_requested;
+  static bool stopping;
+  static uint64_t last_refresh;
+  static std::atomic<uint32_t> generation;
+  static IDWriteFactory *factory;
+  static IDWriteFontCollection *collection;
+  static std::unordered_map<std::wstring, std::wstring> families;
+  static std::unordered_map<std::wstring, FontResolution> resolved;
+  static std::unordered_set<std::wstring> misses;
+};
@@ -0,0 +1,148 @@
+#include "GlyphRunCache.h"
+
+#include <obs-module.h>
+
+#include "CustomTextRenderer.h"
+
+/* renders a run may go unused before its outline is dropped */
+#define RUN_CACHE_GENERATIONS 4
+#define RUN_CACHE_MAX_ENTRIES 4096
+
+template <class T>
+static inline void key_append(std::string &key, const T &value) {
+  key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <class T>
+static inline void key_append(std::string &key, const T *values,
+                              UINT32 count) {
+  if (values)
+    key.append(reinterpret_cast<const char *>(values), sizeof(T) * count);
+  else
+    key.append(sizeof(T) * count, '\0');
+}
+
+HRESULT GlyphRunCache::Build(ID2D1Factory *factory,
+                             const DWRITE_GLYPH_RUN *glyphRun,
+                             ID2D1PathGeometry **geometry) {
+  ID2D1PathGeometry *pPathGeometry = nullptr;
+  HRESULT hr = factory->CreatePathGeometry(&pPathGeometry);
+
+  ID2D1GeometrySink *pSink = nullptr;
+  if (SUCCEEDED(hr)) {
+    hr = pPathGeometry->Open(&pSink);
+  }
+
+  if (SUCCEEDED(hr)) {
+    hr = glyphRun->fontFace->GetGlyphRunOutline(
+        glyphRun->fontEmSize, glyphRun->glyphIndices, glyphRun->glyphAdvances,
+        glyphRun->glyphOffsets, glyphRun->glyphCount, glyphRun->isSideways,
+        glyphRun->bidiLevel & 1, pSink);
+  }
+
+  if (SUCCEEDED(hr)) {
+    hr = pSink->Close();
+  }
+
+  SafeRelease(&pSink);
+  if (FAILED(hr)) SafeRelease(&pPathGeometry);
+
+  *geometry = pPathGeometry;
+  return hr;
+}
+
+HRESULT GlyphRunCache::Get(ID2D1Factory *factory,
+                           const DWRITE_GLYPH_RUN *glyphRun,
+                           ID2D1PathGeometry **geometry) {
+  key.clear();
+  key_append(key, glyphRun->fontFace);
+  key_append(key, glyphRun->fontEmSize);
+  key_append(key, glyphRun->isSideways);
+  key_append(key, (UINT32)(glyphRun->bidiLevel & 1));
+  key_append(key, glyphRun->glyphIndices, glyphRun->glyphCount);
+  key_append(key, glyphRun->glyphAdvances, glyphRun->glyphCount);
+  key_append(key, glyphRun->glyphOffsets, glyphRun->glyphCount);
+
+  auto it = entries.find(key);
+  if (it != entries.end()) {
+    hits++;
+    it->second.last_used = generation;
+    *geometry = it->second.geometry;
+    (*geometry)->AddRef();
+    return S_OK;
+  }
+
+  misses++;
+  HRESULT hr = Build(factory, glyphRun, geometry);
+  if (FAILED(hr) || entries.size() >= RUN_CACHE_MAX_ENTRIES) return hr;
+
+  /* the face is held so its address cannot be reused by another face */
+  Entry entry;
+  entry.geometry = *geometry;
+  entry.geometry->AddRef();
+  entry.face = glyphRun->fontFace;
+  entry.face->AddRef();
+  entry.last_used = generation;
+
+  UINT32 segments = 0;
+  entry.geometry->GetSegmentCount(&segments);
+  entry.bytes = key.size() + sizeof(Entry) + segments * 32;
+  bytes += entry.bytes;
+
+  entries.emplace(key, entry);
+  return hr;
+}
+
+bool GlyphRunCache::IsColorFont(IDWriteFontFace *face) {
+  auto it = color_faces.find(face);
+  if (it != color_faces.end()) return it->second;
+
+  bool color = false;
+  IDWriteFontFace2 *face2 = nullptr;
+  if (SUCCEEDED(face->QueryInterface<IDWriteFontFace2>(&face2))) {
+    color = !!face2->IsColorFont();
+    SafeRelease(&face2);
+  }
+
+  /* held like the run entries so the address cannot be reused */
+  face->AddRef();
+  color_faces.emplace(face, color);
+  return color;
+}
+
+void GlyphRunCache::EndRender() {
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (generation - it->second.last_used >= RUN_CACHE_GENERATIONS) {
+      bytes -= it->second.bytes;
+      ReleaseEntry(it->second);
+      it = entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  generation++;
+}
+
+void GlyphRunCache::ReleaseEntry(Entry &entry) {
+  SafeRelease(&entry.geometry);
+  SafeRelease(&entry.face);
+}
+
+void GlyphRunCache::Clear() {
+  for (auto &entry : entries) ReleaseEntry(entry.second);
+  entries.clear();
+  bytes = 0;
+
+  for (auto &face : color_faces) face.first->Release();
+  color_faces.clear();
+}
+
+void GlyphRunCache::LogStats(const char *name) const {
+  if (!hits && !misses) return;
+
+  blog(LOG_INFO,
+       "[text_directwrite] '%s': glyph run outlines %llu reused, %llu built "
+       "(%.1f%% hit rate)",
+       name, (unsigned long long)hits, (unsigned long long)misses,
+       hits * 100.0 / (hits + misses));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <d2d1.h>
+#include <dwrite.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+/* Outline geometry of the glyph runs a source has drawn.
+ *
+ * Chat overlays draw the same runs over and over: every new line renders
+ * the lines above it again, and names and labels recur. A run is keyed by
+ * its font face, size, orientation and its glyph ids, advances and
+ * offsets, which is everything that shapes its outline, so the geometry
+ * is built once and only moved to its baseline afterwards. Runs not drawn
+ * in the last few renders are dropped. Geometry belongs to the source's
+ * D2D factory, which is single threaded, so each source owns one cache.
+ *
+ * Whether a face has color glyphs (COLR/CPAL and the like) is asked once per
+ * face and kept until the cache is cleared; runs of other faces never pay
+ * for the color layer lookup. */
+class GlyphRunCache {
+ public:
+  GlyphRunCache() = default;
+  GlyphRunCache(const GlyphRunCache &) = delete;
+  GlyphRunCache &operator=(const GlyphRunCache &) = delete;
+  inline ~GlyphRunCache() { Clear(); }
+
+  /* returns the run outline with a reference held for the caller */
+  HRESULT Get(ID2D1Factory *factory, const DWRITE_GLYPH_RUN *glyphRun,
+              ID2D1PathGeometry **geometry);
+
+  bool IsColorFont(IDWriteFontFace *face);
+
+  void EndRender();
+  void Clear();
+
+  inline size_t MemoryBytes() const { return bytes; }
+  void LogStats(const char *name) const;
+
+ private:
+  struct Entry {
+    ID2D1PathGeometry *geometry = nullptr;
+    IDWriteFontFace *face = nullptr;
+    uint64_t last_used = 0;
+    size_t bytes = 0;
+  };
+
+  static HRESULT Build(ID2D1Factory *factory,
+                       const DWRITE_GLYPH_RUN *glyphRun,
+                       ID2D1PathGeometry **geometry);
+  static void ReleaseEntry(Entry &entry);
+
+  std::unordered_map<std::string, Entry> entries;
+  std::unordered_map<IDWriteFontFace *, bool> color_faces;
+  std::string key;
+  uint64_t generation = 0;
+  size_t bytes = 0;
+
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+
+#include <util/platform.h>
+#include <util/util.hpp>
+
+MappedFile::MappedFile(const char *path) {
+  BPtr<wchar_t> wpath;
+  if (!path || !os_utf8_to_wcs_ptr(path, 0, &wpath)) return;
+
+  hFile = CreateFileW(wpath, GENERIC_READ,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                      NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (hFile == INVALID_HANDLE_VALUE) return;
+
+  LARGE_INTEGER file_size = {};
+  if (!GetFileSizeEx(hFile, &file_size)) return;
+
+  if ((ULONGLONG)file_size.QuadPart > (ULONGLONG)SIZE_MAX) return;
+
+  /* empty files cannot be mapped but are perfectly valid text */
+  valid = true;
+  if (!file_size.QuadPart) return;
+
+  /* the size read above is the size of the view, whatever writers append
+   * meanwhile; a file that shrank below it fails to map */
+  hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY,
+                                (DWORD)(file_size.QuadPart >> 32),
+                                (DWORD)file_size.QuadPart, NULL);
+  if (!hMapping) {
+    valid = false;
+    return;
+  }
+
+  view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0,
+                       (SIZE_T)file_size.QuadPart);
+  if (!view) {
+    valid = false;
+    return;
+  }
+
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(view);
+  size = (size_t)file_size.QuadPart;
+
+  if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+    bytes += 3;
+    size -= 3;
+  } else if (size >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE) {
+    bytes += 2;
+    size -= 2;
+    size &= ~(size_t)1;
+    utf16 = true;
+  }
+
+  data = reinterpret_cast<const char *>(bytes);
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+void MappedFile::Close() {
+  if (view) UnmapViewOfFile(view);
+  if (hMapping) CloseHandle(hMapping);
+  if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+
+  view = nullptr;
+  hMapping = NULL;
+  hFile = INVALID_HANDLE_VALUE;
+  data = "";
+  size = 0;
+}
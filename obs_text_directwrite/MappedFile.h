@@ -0,0 +1,50 @@
+#pragma once
+
+#include <windows.h>
+
+#include <stddef.h>
+
+/* Read-only view of a whole text file.
+ *
+ * The file is mapped instead of read into a heap buffer, so reloading a large
+ * file costs no allocation of its size; callers convert or scan only the part
+ * they need straight from the view. A leading UTF-8 BOM is skipped and a
+ * UTF-16LE BOM switches the view to wide characters.
+ *
+ * While a file is mapped, writers cannot truncate it (they fail with
+ * ERROR_USER_MAPPED_FILE), so a load closes the view as soon as it has read
+ * what it needs and never keeps it past returning. The size is read once and
+ * the mapping and view are created with exactly that size, so data appended
+ * while the file is open is left for the next reload. */
+class MappedFile {
+ public:
+  MappedFile(const char *path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /* unmaps the file; the view reads as empty afterwards */
+  void Close();
+
+  inline bool Valid() const { return valid; }
+  inline bool IsUtf16() const { return utf16; }
+
+  inline const char *Data() const { return data; }
+  inline const wchar_t *Wide() const {
+    return reinterpret_cast<const wchar_t *>(data);
+  }
+
+  /* length in code units of the encoding, excluding the BOM */
+  inline size_t Length() const { return utf16 ? size / sizeof(wchar_t) : size; }
+
+ private:
+  HANDLE hFile = INVALID_HANDLE_VALUE;
+  HANDLE hMapping = NULL;
+  void *view = nullptr;
+
+  const char *data = "";
+  size_t size = 0;
+  bool utf16 = false;
+  bool valid = false;
+};
@@ -0,0 +1,139 @@
+#include "MemoryBudget.h"
+
+#include <obs-module.h>
+#include <util/config-file.h>
+#include <util/platform.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "CachedFontFallback.h"
+
+#define DEFAULT_BUDGET_MB 512
+#define CHECK_INTERVAL_NS 1000000000ULL
+#define MB (1024.0 * 1024.0)
+
+using namespace std;
+
+mutex MemoryBudget::mutex;
+vector<MemoryConsumer *> MemoryBudget::consumers;
+size_t MemoryBudget::budget = (size_t)DEFAULT_BUDGET_MB * 1024 * 1024;
+uint64_t MemoryBudget::last_check = 0;
+uint64_t MemoryBudget::evictions = 0;
+
+atomic<size_t> MemoryBudget::last_cpu{0};
+atomic<size_t> MemoryBudget::last_gpu{0};
+atomic<size_t> MemoryBudget::last_caches{0};
+
+void MemoryBudget::Load() {
+  char *dir = obs_module_config_path("");
+  char *path = obs_module_config_path("config.ini");
+  if (dir) os_mkdirs(dir);
+
+  config_t *config = nullptr;
+  if (path && config_open(&config, path, CONFIG_OPEN_ALWAYS) == CONFIG_SUCCESS) {
+    /* written back so the setting is there to edit */
+    if (!config_has_user_value(config, "Memory", "BudgetMB")) {
+      config_set_uint(config, "Memory", "BudgetMB", DEFAULT_BUDGET_MB);
+      config_save_safe(config, "tmp", nullptr);
+    }
+
+    uint64_t mb = config_get_uint(config, "Memory", "BudgetMB");
+    if (mb) budget = (size_t)mb * 1024 * 1024;
+    config_close(config);
+  }
+
+  bfree(path);
+  bfree(dir);
+}
+
+void MemoryBudget::Add(MemoryConsumer *consumer) {
+  lock_guard<std::mutex> lock(mutex);
+  consumers.push_back(consumer);
+}
+
+void MemoryBudget::Remove(MemoryConsumer *consumer) {
+  lock_guard<std::mutex> lock(mutex);
+  consumers.erase(remove(consumers.begin(), consumers.end(), consumer),
+                  consumers.end());
+}
+
+MemoryBudget::Totals MemoryBudget::Measure() {
+  Totals totals;
+  unordered_set<const void *> textures;
+
+  for (MemoryConsumer *consumer : consumers) {
+    MemoryUsage usage = consumer->GetMemoryUsage();
+    totals.cpu += usage.cpu;
+    if (!usage.gpu_owner || textures.insert(usage.gpu_owner).second)
+      totals.gpu += usage.gpu;
+  }
+  totals.caches = CachedFontFallback::MemoryBytes();
+
+  last_cpu = totals.cpu;
+  last_gpu = totals.gpu;
+  last_caches = totals.caches;
+  return totals;
+}
+
+size_t MemoryBudget::Evict(size_t excess) {
+  size_t freed = 0;
+
+  vector<MemoryConsumer *> order = consumers;
+  sort(order.begin(), order.end(),
+       [](MemoryConsumer *a, MemoryConsumer *b) {
+         return a->LastActive() < b->LastActive();
+       });
+
+  for (MemoryConsumer *consumer : order) {
+    if (freed >= excess) return freed;
+    if (!consumer->IsActive()) freed += consumer->ReleaseMemory(false);
+  }
+
+  while (freed < excess) {
+    size_t bytes = CachedFontFallback::EvictOldest();
+    if (!bytes) break;
+    freed += bytes;
+  }
+
+  for (MemoryConsumer *consumer : order) {
+    if (freed >= excess) return freed;
+    if (consumer->IsActive()) freed += consumer->ReleaseMemory(true);
+  }
+
+  return freed;
+}
+
+void MemoryBudget::Enforce() {
+  lock_guard<std::mutex> lock(mutex);
+
+  uint64_t now = os_gettime_ns();
+  if (now - last_check < CHECK_INTERVAL_NS) return;
+  last_check = now;
+
+  Totals totals = Measure();
+  if (totals.Sum() <= budget) return;
+
+  size_t freed = Evict(totals.Sum() - budget);
+  evictions++;
+
+  blog(LOG_INFO,
+       "[text_directwrite] memory %.1f MB over the %.1f MB budget, released "
+       "%.1f MB",
+       (totals.Sum() - budget) / MB, budget / MB, freed / MB);
+}
+
+string MemoryBudget::Report() {
+  char report[256];
+  snprintf(report, sizeof(report), obs_module_text("MemoryUsage"),
+           last_cpu / MB, last_gpu / MB, last_caches / MB, budget / MB);
+  return report;
+}
+
+void MemoryBudget::LogUsage() {
+  blog(LOG_INFO,
+       "[text_directwrite] memory: %.1f MB CPU, %.1f MB GPU, %.1f MB caches "
+       "of a %.1f MB budget, %llu evictions",
+       last_cpu / MB, last_gpu / MB, last_caches / MB, budget / MB,
+       (unsigned long long)evictions);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct MemoryUsage {
+  size_t cpu = 0;
+  size_t gpu = 0;
+
+  /* texture shared with identical sources, counted once */
+  const void *gpu_owner = nullptr;
+};
+
+/* Anything that holds memory the budget may take back. */
+class MemoryConsumer {
+ public:
+  virtual MemoryUsage GetMemoryUsage() const = 0;
+  virtual bool IsActive() const = 0;
+  virtual uint64_t LastActive() const = 0;
+
+  /* drop what can be rebuilt and return the bytes freed; an active
+   * consumer keeps what it is showing */
+  virtual size_t ReleaseMemory(bool active) = 0;
+
+ protected:
+  ~MemoryConsumer() = default;
+};
+
+/* Module-wide memory accounting for sources and caches.
+ *
+ * Usage is measured on the video thread at most once a second. Over the
+ * budget, memory is taken back in order of how cheap it is to rebuild:
+ * textures of hidden sources (least recently shown first), then font
+ * fallback tables (least recently used first), then the staging bitmaps of
+ * visible sources. The budget is read from the module config file,
+ * BudgetMB in the [Memory] section. */
+class MemoryBudget {
+ public:
+  static void Load();
+
+  static void Add(MemoryConsumer *consumer);
+  static void Remove(MemoryConsumer *consumer);
+
+  static void Enforce();
+
+  static std::string Report();
+  static void LogUsage();
+
+ private:
+  struct Totals {
+    size_t cpu = 0;
+    size_t gpu = 0;
+    size_t caches = 0;
+
+    inline size_t Sum() const { return cpu + gpu + caches; }
+  };
+
+  static Totals Measure();
+  static size_t Evict(size_t excess);
+
+  static std::mutex mutex;
+  static std::vector<MemoryConsumer *> consumers;
+  static size_t budget;
+  static uint64_t last_check;
+  static uint64_t evictions;
+
+  static std::atomic<size_t> last_cpu;
+  static std::atomic<size_t> last_gpu;
+  static std::atomic<size_t> last_caches;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+/* Wire format of the local push channel.
+ *
+ * A client connects to the pipe and writes any number of frames. Each frame
+ * is a push_header followed by name_len bytes of UTF-8 source name and
+ * payload_len bytes of UTF-8 text. Integers are little-endian. */
+
+#define PUSH_PIPE_NAME L"\\\\.\\pipe\\obs-text-directwrite"
+#define PUSH_MAX_PAYLOAD (16 * 1024 * 1024)
+
+enum push_op : uint8_t {
+  PUSH_REPLACE = 1,
+  PUSH_APPEND = 2,
+  PUSH_CLEAR = 3,
+  PUSH_APPEND_LINE = 4,
+};
+
+#pragma pack(push, 1)
+struct push_header {
+  uint8_t op;
+  uint8_t reserved;
+  uint16_t name_len;
+  uint32_t payload_len;
+};
+#pragma pack(pop)
+
+/* folds one frame into the text waiting to be applied to a source. replace
+ * and clear start over and set reset; append and append_line add to what is
+ * waiting, so consecutive lines accumulate. */
+static inline void push_merge(std::string &pending, bool &reset, push_op op,
+                              const char *str, size_t len) {
+  if (op == PUSH_REPLACE || op == PUSH_CLEAR) {
+    reset = true;
+    pending.clear();
+  }
+  if (op != PUSH_CLEAR) pending.append(str, len);
+  if (op == PUSH_APPEND_LINE) pending += '\n';
+}
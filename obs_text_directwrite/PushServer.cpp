@@ -0,0 +1,123 @@
+#include "PushServer.h"
+
+#include <obs-module.h>
+
+using namespace std;
+
+push_handler_t PushServer::handler = nullptr;
+thread PushServer::thread;
+HANDLE PushServer::stop_event = NULL;
+HANDLE PushServer::io_event = NULL;
+
+void PushServer::Start(push_handler_t handler_) {
+  handler = handler_;
+  stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+  io_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+  if (!stop_event || !io_event) return;
+
+  thread = std::thread(Run);
+}
+
+void PushServer::Stop() {
+  if (stop_event) SetEvent(stop_event);
+  if (thread.joinable()) thread.join();
+
+  if (stop_event) CloseHandle(stop_event);
+  if (io_event) CloseHandle(io_event);
+  stop_event = NULL;
+  io_event = NULL;
+}
+
+bool PushServer::Wait(HANDLE pipe, OVERLAPPED *ov, DWORD *bytes) {
+  HANDLE events[] = {ov->hEvent, stop_event};
+  if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+    CancelIoEx(pipe, ov);
+    GetOverlappedResult(pipe, ov, bytes, TRUE);
+    return false;
+  }
+  return !!GetOverlappedResult(pipe, ov, bytes, FALSE);
+}
+
+bool PushServer::Connect(HANDLE pipe) {
+  OVERLAPPED ov = {};
+  ov.hEvent = io_event;
+
+  if (ConnectNamedPipe(pipe, &ov)) return true;
+
+  DWORD error = GetLastError();
+  if (error == ERROR_PIPE_CONNECTED) return true;
+  if (error != ERROR_IO_PENDING) return false;
+
+  DWORD bytes;
+  return Wait(pipe, &ov, &bytes);
+}
+
+bool PushServer::Read(HANDLE pipe, void *data, size_t len) {
+  char *pos = reinterpret_cast<char *>(data);
+
+  while (len) {
+    OVERLAPPED ov = {};
+    ov.hEvent = io_event;
+    DWORD chunk = len > (1 << 20) ? (1 << 20) : (DWORD)len;
+    DWORD bytes = 0;
+
+    if (ReadFile(pipe, pos, chunk, NULL, &ov)) {
+      if (!GetOverlappedResult(pipe, &ov, &bytes, FALSE)) return false;
+    } else if (GetLastError() != ERROR_IO_PENDING ||
+               !Wait(pipe, &ov, &bytes)) {
+      return false;
+    }
+
+    if (!bytes) return false;
+    pos += bytes;
+    len -= bytes;
+  }
+  return true;
+}
+
+void PushServer::Serve(HANDLE pipe) {
+  push_header header;
+  string name;
+  string payload;
+
+  while (Read(pipe, &header, sizeof(header))) {
+    if (header.op < PUSH_REPLACE || header.op > PUSH_APPEND_LINE ||
+        header.payload_len > PUSH_MAX_PAYLOAD) {
+      blog(LOG_WARNING, "[text_directwrite] push: malformed frame, dropping "
+                        "client");
+      return;
+    }
+
+    name.resize(header.name_len);
+    payload.resize(header.payload_len);
+    if (header.name_len && !Read(pipe, &name[0], name.size())) return;
+    if (header.payload_len && !Read(pipe, &payload[0], payload.size()))
+      return;
+
+    handler((push_op)header.op, name, payload);
+  }
+}
+
+void PushServer::Run() {
+  while (WaitForSingleObject(stop_event, 0) != WAIT_OBJECT_0) {
+    HANDLE pipe = CreateNamedPipeW(
+        PUSH_PIPE_NAME,
+        PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED |
+            FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+            PIPE_REJECT_REMOTE_CLIENTS,
+        1, 0, 64 * 1024, 0, NULL);
+    if (pipe == INVALID_HANDLE_VALUE) {
+      blog(LOG_WARNING,
+           "[text_directwrite] push: could not create pipe (error %lu), "
+           "is another instance running?",
+           GetLastError());
+      return;
+    }
+
+    if (Connect(pipe)) Serve(pipe);
+
+    DisconnectNamedPipe(pipe);
+    CloseHandle(pipe);
+  }
+}
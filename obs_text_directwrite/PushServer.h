@@ -0,0 +1,35 @@
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+#include <thread>
+
+#include "PushProtocol.h"
+
+typedef void (*push_handler_t)(push_op op, const std::string &name,
+                               const std::string &payload);
+
+/* Module-wide named pipe endpoint for pushing text into sources.
+ *
+ * One client is served at a time on a background thread; every complete
+ * frame is handed to the handler, which queues it on the target source. The
+ * pipe rejects remote clients and keeps the default security descriptor,
+ * so only processes of the same user can write to it. */
+class PushServer {
+ public:
+  static void Start(push_handler_t handler);
+  static void Stop();
+
+ private:
+  static void Run();
+  static bool Connect(HANDLE pipe);
+  static void Serve(HANDLE pipe);
+  static bool Wait(HANDLE pipe, OVERLAPPED *ov, DWORD *bytes);
+  static bool Read(HANDLE pipe, void *data, size_t len);
+
+  static push_handler_t handler;
+  static std::thread thread;
+  static HANDLE stop_event;
+  static HANDLE io_event;
+};
@@ -0,0 +1,40 @@
+#include "RenderArena.h"
+
+#include <obs-module.h>
+
+void *CountingResource::do_allocate(size_t size, size_t alignment) {
+  allocations++;
+  bytes += size;
+  return upstream->allocate(size, alignment);
+}
+
+void CountingResource::do_deallocate(void *p, size_t size, size_t alignment) {
+  upstream->deallocate(p, size, alignment);
+}
+
+bool CountingResource::do_is_equal(const std::pmr::memory_resource &other) const
+    noexcept {
+  return this == &other;
+}
+
+void RenderArena::Reset() {
+  if (!front.allocations) return;
+
+  if (front.bytes > peak_bytes) peak_bytes = front.bytes;
+  allocations += front.allocations;
+  resets++;
+
+  front.allocations = 0;
+  front.bytes = 0;
+  arena.release();
+}
+
+void RenderArena::LogStats(const char *name) const {
+  if (!resets) return;
+
+  blog(LOG_INFO,
+       "[text_directwrite] '%s': arena served %llu allocations over %llu "
+       "renders, peak %zu bytes per render, %llu heap allocations",
+       name, (unsigned long long)allocations, (unsigned long long)resets,
+       peak_bytes, (unsigned long long)heap.allocations);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory_resource>
+
+/* Memory resource that counts what passes through it. */
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  explicit CountingResource(std::pmr::memory_resource *upstream_)
+      : upstream(upstream_) {}
+
+  uint64_t allocations = 0;
+  size_t bytes = 0;
+
+ private:
+  std::pmr::memory_resource *upstream;
+
+  void *do_allocate(size_t size, size_t alignment) override;
+  void do_deallocate(void *p, size_t size, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override;
+};
+
+/* Per-source bump allocator for temporaries of one render.
+ *
+ * Render stages allocate their scratch strings and vectors from Resource()
+ * through std::pmr containers; nothing is freed individually and Reset()
+ * drops everything once the render is done. Renders that fit in the inline
+ * buffer never touch the heap. */
+class RenderArena {
+ public:
+  RenderArena() = default;
+  RenderArena(const RenderArena &) = delete;
+  RenderArena &operator=(const RenderArena &) = delete;
+
+  inline std::pmr::memory_resource *Resource() { return &front; }
+
+  void Reset();
+  void LogStats(const char *name) const;
+
+ private:
+  alignas(16) char initial[16384];
+  CountingResource heap{std::pmr::new_delete_resource()};
+  std::pmr::monotonic_buffer_resource arena{initial, sizeof(initial), &heap};
+  CountingResource front{&arena};
+
+  uint64_t resets = 0;
+  uint64_t allocations = 0;
+  size_t peak_bytes = 0;
+};
@@ -0,0 +1,65 @@
+#include "RenderScheduler.h"
+
+#include <obs-module.h>
+
+#define MAX_WAIT_FRAMES 4
+
+uint64_t RenderScheduler::frame_time = 0;
+uint64_t RenderScheduler::spent_ns = 0;
+uint64_t RenderScheduler::warmup_ns = 0;
+uint32_t RenderScheduler::renders = 0;
+uint32_t RenderScheduler::warmups = 0;
+uint32_t RenderScheduler::deferred = 0;
+uint32_t RenderScheduler::deferred_last = 0;
+bool RenderScheduler::in_warmup = false;
+
+void RenderScheduler::BeginFrame() {
+  uint64_t now = obs_get_video_frame_time();
+  if (now != frame_time) {
+    frame_time = now;
+    spent_ns = 0;
+    warmup_ns = 0;
+    renders = 0;
+    warmups = 0;
+    deferred_last = deferred;
+    deferred = 0;
+  }
+}
+
+bool RenderScheduler::Acquire(uint32_t frames_waited) {
+  BeginFrame();
+
+  /* a quarter of the frame interval is left for text, the first render of a
+   * frame always goes through so a single slow source still makes progress */
+  uint64_t budget_ns = obs_get_frame_interval_ns() / 4;
+  if (renders && spent_ns >= budget_ns && frames_waited < MAX_WAIT_FRAMES) {
+    deferred++;
+    return false;
+  }
+
+  renders++;
+  return true;
+}
+
+bool RenderScheduler::AcquireWarmup() {
+  BeginFrame();
+
+  uint64_t budget_ns = obs_get_frame_interval_ns() / 4;
+  if (warmups || deferred || deferred_last ||
+      spent_ns + warmup_ns >= budget_ns)
+    return false;
+
+  warmups++;
+  in_warmup = true;
+  return true;
+}
+
+/* time after AcquireWarmup is the warm-up's, everything else counts against
+ * the visible render budget, catch-up renders included */
+void RenderScheduler::Release(uint64_t elapsed_ns) {
+  if (in_warmup)
+    warmup_ns += elapsed_ns;
+  else
+    spent_ns += elapsed_ns;
+  in_warmup = false;
+}
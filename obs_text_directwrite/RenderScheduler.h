@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Spreads text renders from all sources across video frames.
+ *
+ * Every source ticks on the video thread, so a frame in which many sources
+ * become dirty at once would otherwise rasterize all of them back to back.
+ * Each frame gets a time budget; once it is used up, remaining sources keep
+ * their pending render for a later frame. A source that has already waited
+ * MAX_WAIT_FRAMES frames is let through regardless so nothing starves.
+ *
+ * Shown and active sources come before hidden ones regardless of the order
+ * they tick in. Hidden sources that still have to build their DirectWrite
+ * resources get one warm-up slot per frame, only while the budget has room
+ * and no visible render was held back in this or the previous frame. Warm-up
+ * time is kept apart from the budget visible renders are measured against,
+ * so a hidden source ticking first never pushes a visible one out. */
+class RenderScheduler {
+ public:
+  static bool Acquire(uint32_t frames_waited);
+  static bool AcquireWarmup();
+  static void Release(uint64_t elapsed_ns);
+
+ private:
+  static void BeginFrame();
+
+  static uint64_t frame_time;
+  static uint64_t spent_ns;
+  static uint64_t warmup_ns;
+  static uint32_t renders;
+  static uint32_t warmups;
+  static uint32_t deferred;
+  static uint32_t deferred_last;
+  static bool in_warmup;
+};
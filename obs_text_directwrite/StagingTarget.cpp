@@ -0,0 +1,127 @@
+#include "StagingTarget.h"
+
+#include <string.h>
+
+#include "Compositing.h"
+#include "CustomTextRenderer.h"
+
+IWICImagingFactory *StagingTarget::wic = nullptr;
+
+/* called from module load on the UI thread, which already has COM set up.
+ * WIC objects are free-threaded, the video thread uses them directly. */
+void StagingTarget::Startup() {
+  HRESULT hr =
+      CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+                       IID_PPV_ARGS(&wic));
+  if (FAILED(hr)) {
+    blog(LOG_WARNING,
+         "[text_directwrite] WIC unavailable (0x%08lX), uploading through "
+         "GDI surfaces",
+         hr);
+    wic = nullptr;
+  }
+}
+
+void StagingTarget::Shutdown() { SafeRelease(&wic); }
+
+bool StagingTarget::SavePng(const wchar_t *path, const uint8_t *bgra, UINT cx,
+                            UINT cy, UINT stride) {
+  if (!wic) return false;
+
+  IWICStream *stream = nullptr;
+  IWICBitmapEncoder *encoder = nullptr;
+  IWICBitmapFrameEncode *frame = nullptr;
+  WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+
+  HRESULT hr = wic->CreateStream(&stream);
+  if (SUCCEEDED(hr)) hr = stream->InitializeFromFilename(path, GENERIC_WRITE);
+  if (SUCCEEDED(hr))
+    hr = wic->CreateEncoder(GUID_ContainerFormatPng, nullptr, &encoder);
+  if (SUCCEEDED(hr)) hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
+  if (SUCCEEDED(hr)) hr = encoder->CreateNewFrame(&frame, nullptr);
+  if (SUCCEEDED(hr)) hr = frame->Initialize(nullptr);
+  if (SUCCEEDED(hr)) hr = frame->SetSize(cx, cy);
+  if (SUCCEEDED(hr)) hr = frame->SetPixelFormat(&format);
+  if (SUCCEEDED(hr) && format != GUID_WICPixelFormat32bppBGRA) hr = E_FAIL;
+  if (SUCCEEDED(hr))
+    hr = frame->WritePixels(cy, stride, stride * cy, (BYTE *)bgra);
+  if (SUCCEEDED(hr)) hr = frame->Commit();
+  if (SUCCEEDED(hr)) hr = encoder->Commit();
+
+  SafeRelease(&frame);
+  SafeRelease(&encoder);
+  SafeRelease(&stream);
+  return SUCCEEDED(hr);
+}
+
+StagingTarget::~StagingTarget() { Release(); }
+
+void StagingTarget::Release() {
+  SafeRelease(&target);
+  SafeRelease(&bitmap);
+  owner = nullptr;
+  width = 0;
+  height = 0;
+}
+
+bool StagingTarget::Prepare(ID2D1Factory *factory, UINT cx, UINT cy) {
+  if (!wic) return false;
+  if (target && owner == factory && width == cx && height == cy) return true;
+
+  Release();
+
+  HRESULT hr = wic->CreateBitmap(cx, cy, GUID_WICPixelFormat32bppPBGRA,
+                                 WICBitmapCacheOnDemand, &bitmap);
+  if (SUCCEEDED(hr)) {
+    D2D1_RENDER_TARGET_PROPERTIES props = D2D1::RenderTargetProperties(
+        D2D1_RENDER_TARGET_TYPE_DEFAULT,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM,
+                          D2D1_ALPHA_MODE_PREMULTIPLIED));
+    hr = factory->CreateWicBitmapRenderTarget(bitmap, &props, &target);
+  }
+  if (FAILED(hr)) {
+    Release();
+    return false;
+  }
+
+  owner = factory;
+  width = cx;
+  height = cy;
+  return true;
+}
+
+bool StagingTarget::Upload(gs_texture_t *tex, uint32_t bk) {
+  if (!bitmap || !tex) return false;
+
+  WICRect rect = {0, 0, (INT)width, (INT)height};
+  IWICBitmapLock *lock = nullptr;
+  UINT stride = 0;
+  UINT size = 0;
+  BYTE *src = nullptr;
+
+  HRESULT hr = bitmap->Lock(&rect, WICBitmapLockRead, &lock);
+  if (SUCCEEDED(hr)) hr = lock->GetStride(&stride);
+  if (SUCCEEDED(hr)) hr = lock->GetDataPointer(&size, &src);
+
+  uint8_t *dst = nullptr;
+  uint32_t linesize = 0;
+  bool mapped = SUCCEEDED(hr) && gs_texture_map(tex, &dst, &linesize);
+  if (mapped) {
+    /* both sides may pad their rows differently */
+    size_t row = (size_t)width * 4;
+    for (UINT y = 0; y < height; y++) {
+      uint8_t *dst_row = dst + (size_t)y * linesize;
+      const BYTE *src_row = src + (size_t)y * stride;
+
+      if (bk >> 24)
+        composite_over_solid((uint32_t *)dst_row, (const uint32_t *)src_row,
+                             width, bk);
+      else
+        memcpy(dst_row, src_row, row);
+    }
+    gs_texture_unmap(tex);
+  }
+
+  SafeRelease(&lock);
+  return mapped;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d2d1.h>
+#include <obs-module.h>
+#include <wincodec.h>
+#include <windows.h>
+
+/* Persistent CPU bitmap that a source rasterizes into.
+ *
+ * Direct2D draws into a WIC bitmap owned by the source, and the pixels are
+ * then copied row by row into a mapped GS_DYNAMIC texture. Drawing needs
+ * no graphics context and no GDI surface, so the graphics lock is only
+ * held for the copy. The bitmap is kept between renders and only recreated
+ * when the texture size changes. */
+class StagingTarget {
+ public:
+  static void Startup();
+  static void Shutdown();
+
+  /* writes BGRA rows to a PNG file, byte for byte as drawn */
+  static bool SavePng(const wchar_t *path, const uint8_t *bgra, UINT cx,
+                      UINT cy, UINT stride);
+
+  StagingTarget() = default;
+  ~StagingTarget();
+
+  StagingTarget(const StagingTarget &) = delete;
+  StagingTarget &operator=(const StagingTarget &) = delete;
+
+  bool Prepare(ID2D1Factory *factory, UINT cx, UINT cy);
+  inline ID2D1RenderTarget *Target() const { return target; }
+  inline size_t Bytes() const { return (size_t)width * height * 4; }
+
+  /* must be called inside the graphics context. the bitmap is drawn on a
+   * transparent background, bk (premultiplied BGRA) is composited under it
+   * while the rows are copied. */
+  bool Upload(gs_texture_t *tex, uint32_t bk);
+
+  void Release();
+
+ private:
+  static IWICImagingFactory *wic;
+
+  IWICBitmap *bitmap = nullptr;
+  ID2D1RenderTarget *target = nullptr;
+  ID2D1Factory *owner = nullptr;
+  UINT width = 0;
+  UINT height = 0;
+};
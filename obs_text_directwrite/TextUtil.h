@@ -0,0 +1,60 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+
+/* Text and paint helpers shared by the source and the regression tool. */
+
+/* start of the last lines of a string; a trailing newline does not count as
+ * a line of its own */
+template <class T>
+static const T *chatlog_tail(const T *str, size_t len, int lines) {
+  if (!len) return str;
+
+  const T *end = str + len;
+  const T *temp = end;
+
+  while (temp != str) {
+    temp--;
+
+    if (temp[0] == '\n' && temp + 1 != end) {
+      if (!--lines) break;
+    }
+  }
+
+  return *temp == '\n' ? temp + 1 : temp;
+}
+
+/* end points of a gradient crossing a width x height box at dir degrees,
+ * as start x, start y, end x, end y */
+static inline void calculate_gradient_axis(float dir, float width,
+                                           float height, float axis[4]) {
+  const float deg = 57.2957795f;
+  float angle = atanf(height / width) * deg;
+
+  if (dir <= angle || dir > 360.f - angle) {
+    float y = width / 2.f * tanf(dir / deg);
+    axis[0] = width;
+    axis[1] = height / 2.f - y;
+    axis[2] = 0.f;
+    axis[3] = height / 2.f + y;
+  } else if (dir <= 180.f - angle && dir > angle) {
+    float x = height / 2.f * tanf((90.f - dir) / deg);
+    axis[0] = width / 2.f + x;
+    axis[1] = 0.f;
+    axis[2] = width / 2.f - x;
+    axis[3] = height;
+  } else if (dir <= 180.f + angle && dir > 180.f - angle) {
+    float y = width / 2.f * tanf(dir / deg);
+    axis[0] = 0.f;
+    axis[1] = height / 2.f + y;
+    axis[2] = width;
+    axis[3] = height / 2.f - y;
+  } else {
+    float x = height / 2.f * tanf((270.f - dir) / deg);
+    axis[0] = width / 2.f - x;
+    axis[1] = height;
+    axis[2] = width / 2.f + x;
+    axis[3] = 0.f;
+  }
+}
@@ -0,0 +1,34 @@
+#include "TextureCache.h"
+
+using namespace std;
+
+mutex TextureCache::mutex;
+unordered_map<uint64_t, TextureCache::Entry> TextureCache::entries;
+
+shared_ptr<const RenderOutput> TextureCache::Find(uint64_t hash,
+                                                  string_view key) {
+  lock_guard<std::mutex> lock(mutex);
+
+  auto entry = entries.find(hash);
+  if (entry == entries.end() || entry->second.key != key) return nullptr;
+
+  shared_ptr<const RenderOutput> output = entry->second.output.lock();
+  if (!output) entries.erase(entry);
+  return output;
+}
+
+void TextureCache::Insert(uint64_t hash, string_view key,
+                          const shared_ptr<const RenderOutput> &output) {
+  lock_guard<std::mutex> lock(mutex);
+
+  for (auto entry = entries.begin(); entry != entries.end();) {
+    if (entry->second.output.expired())
+      entry = entries.erase(entry);
+    else
+      ++entry;
+  }
+
+  Entry &entry = entries[hash];
+  entry.key.assign(key.data(), key.size());
+  entry.output = output;
+}
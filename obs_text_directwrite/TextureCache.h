@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct RenderOutput;
+
+/* Module-wide map from render inputs to the output they produced.
+ *
+ * The key is a byte string of everything that affects the pixels: the text,
+ * the format and paint settings and the extents. Duplicated sources build
+ * the same key, so only the first renders and the rest adopt its output.
+ * Entries are weak, a texture lives only as long as some source shows it.
+ *
+ * Entries are indexed by the caller's ContentHash of the key and keep a
+ * copy of the key to rule out collisions, so lookups can take a key built
+ * in scratch memory. */
+class TextureCache {
+ public:
+  static std::shared_ptr<const RenderOutput> Find(uint64_t hash,
+                                                  std::string_view key);
+  static void Insert(uint64_t hash, std::string_view key,
+                     const std::shared_ptr<const RenderOutput> &output);
+
+ private:
+  struct Entry {
+    std::string key;
+    std::weak_ptr<const RenderOutput> output;
+  };
+
+  static std::mutex mutex;
+  static std::unordered_map<uint64_t, Entry> entries;
+};
@@ -0,0 +1,138 @@
+#include "TraceLog.h"
+
+#include <obs-module.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/platform.h>
+#include <windows.h>
+
+using namespace std;
+
+/* written only by its own thread; head is published after the slot */
+struct TraceLog::Ring {
+  DWORD tid;
+  atomic<uint64_t> head{0};
+  TraceEvent events[TRACE_RING_SIZE];
+};
+
+atomic_bool TraceLog::enabled{false};
+string TraceLog::path;
+mutex TraceLog::rings_mutex;
+vector<unique_ptr<TraceLog::Ring>> TraceLog::rings;
+
+uint64_t TraceScope::Now() { return os_gettime_ns(); }
+
+void TraceLog::Start() {
+  const char *env = getenv(TRACE_ENV);
+  if (!env || !*env) return;
+
+  path = env;
+  enabled = true;
+  blog(LOG_INFO, "[text_directwrite] tracing to '%s'", path.c_str());
+}
+
+void TraceLog::Stop() {
+  if (!enabled) return;
+
+  Dump(path.c_str());
+  enabled = false;
+}
+
+/* rings live until the module unloads, a thread that exits leaves its
+ * events behind for the next dump */
+TraceLog::Ring *TraceLog::ThreadRing() {
+  thread_local Ring *ring = nullptr;
+  if (ring) return ring;
+
+  unique_ptr<Ring> next = make_unique<Ring>();
+  next->tid = GetCurrentThreadId();
+  ring = next.get();
+
+  lock_guard<mutex> lock(rings_mutex);
+  rings.push_back(move(next));
+  return ring;
+}
+
+void TraceLog::Record(const char *name, const char *source, uint64_t begin,
+                      uint64_t end) {
+  Ring *ring = ThreadRing();
+  uint64_t head = ring->head.load(memory_order_relaxed);
+
+  TraceEvent &event = ring->events[head % TRACE_RING_SIZE];
+  event.name = name;
+  event.begin = begin;
+  event.end = end;
+
+  /* long names are cut before the lead byte of a character that would not
+   * fit, so the JSON never gets half a UTF-8 sequence */
+  size_t len = source ? strlen(source) : 0;
+  if (len > TRACE_NAME_LEN - 1) {
+    len = TRACE_NAME_LEN - 1;
+    while (len && ((unsigned char)source[len] & 0xC0) == 0x80) len--;
+  }
+  if (len) memcpy(event.source, source, len);
+  event.source[len] = 0;
+
+  ring->head.store(head + 1, memory_order_release);
+}
+
+static void write_json_string(FILE *file, const char *str) {
+  fputc('"', file);
+  for (; *str; str++) {
+    unsigned char c = (unsigned char)*str;
+    if (c == '"' || c == '\\')
+      fprintf(file, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(file, "\\u%04x", c);
+    else
+      fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+bool TraceLog::Dump(const char *out_path) {
+  if (!enabled || !out_path || !*out_path) return false;
+
+  FILE *file = os_fopen(out_path, "wb");
+  if (!file) {
+    blog(LOG_WARNING, "[text_directwrite] cannot write trace to '%s'",
+         out_path);
+    return false;
+  }
+
+  lock_guard<mutex> lock(rings_mutex);
+  size_t count = 0;
+  bool first = true;
+
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+  for (auto &ring : rings) {
+    /* events being written while the dump runs may come out torn, the
+     * ring is never locked against its writer */
+    uint64_t head = ring->head.load(memory_order_acquire);
+    uint64_t begin = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+    for (uint64_t i = begin; i < head; i++) {
+      const TraceEvent &event = ring->events[i % TRACE_RING_SIZE];
+      if (!event.name) continue;
+
+      fprintf(file,
+              "%s\n{\"name\":\"%s\",\"cat\":\"text\",\"ph\":\"X\","
+              "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%lu,"
+              "\"args\":{\"source\":",
+              first ? "" : ",", event.name, event.begin / 1000.0,
+              (event.end - event.begin) / 1000.0, (unsigned long)ring->tid);
+      write_json_string(file, event.source);
+      fputs("}}", file);
+
+      first = false;
+      count++;
+    }
+  }
+  fputs("\n]}\n", file);
+  fclose(file);
+
+  blog(LOG_INFO, "[text_directwrite] wrote %zu trace events to '%s'", count,
+       out_path);
+  return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TRACE_RING_SIZE 65536
+#define TRACE_NAME_LEN 32
+#define TRACE_ENV "OBS_TEXT_DIRECTWRITE_TRACE"
+
+struct TraceEvent {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+  char source[TRACE_NAME_LEN];
+};
+
+/* Opt-in timeline of the text pipeline in Chrome trace-event format.
+ *
+ * Tracing is on when the OBS_TEXT_DIRECTWRITE_TRACE environment variable
+ * names an output file at module load. Each thread records into its own
+ * ring without locks, overwriting its oldest events when full. The rings
+ * are written out as JSON on unload, or on demand through the global
+ * text_directwrite_dump_trace procedure, and open in chrome://tracing or
+ * Perfetto. */
+class TraceLog {
+ public:
+  static void Start();
+  static void Stop();
+
+  static inline bool Enabled() { return enabled; }
+  static void Record(const char *name, const char *source, uint64_t begin,
+                     uint64_t end);
+  static bool Dump(const char *path);
+
+ private:
+  struct Ring;
+  static Ring *ThreadRing();
+
+  static std::atomic_bool enabled;
+  static std::string path;
+  static std::mutex rings_mutex;
+  static std::vector<std::unique_ptr<Ring>> rings;
+};
+
+/* records the enclosing scope as one complete event */
+class TraceScope {
+ public:
+  inline TraceScope(const char *name_, const char *source_)
+      : name(name_), source(source_) {
+    if (name) begin = Now();
+  }
+  inline ~TraceScope() {
+    if (name) TraceLog::Record(name, source, begin, Now());
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+ private:
+  static uint64_t Now();
+
+  const char *name;
+  const char *source;
+  uint64_t begin = 0;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+/* the scope object has to outlive the macro, so instead of an if around it
+ * the arguments are only evaluated when tracing is on */
+#define TRACE_SCOPE(name, source)                                     \
+  TraceScope TRACE_CONCAT(trace_scope_, __LINE__) =                   \
+      TraceLog::Enabled() ? TraceScope((name), (source))              \
+                          : TraceScope(nullptr, nullptr)
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+/* On-disk format of a recorded workload.
+ *
+ * The file starts with WORKLOAD_MAGIC followed by any number of records.
+ * Each record is a workload_record followed by name_len bytes of UTF-8
+ * source name and payload_len bytes of payload. time_ns counts from the
+ * start of the recording. Integers are little-endian.
+ *
+ * payloads by type:
+ *   WORKLOAD_UPDATE  settings passed to Update, as obs_data JSON
+ *   WORKLOAD_FILE    file content as loaded, op is 1 for UTF-16LE
+ *   WORKLOAD_TICK    tick interval in seconds, a 32-bit float
+ *   WORKLOAD_PUSH    pushed text, op holds the push_op */
+
+#define WORKLOAD_MAGIC "OTDWLOG1"
+#define WORKLOAD_MAGIC_LEN 8
+#define WORKLOAD_RECORD_ENV "OBS_TEXT_DIRECTWRITE_RECORD"
+
+enum workload_event : uint8_t {
+  WORKLOAD_UPDATE = 1,
+  WORKLOAD_FILE = 2,
+  WORKLOAD_TICK = 3,
+  WORKLOAD_PUSH = 4,
+};
+
+#pragma pack(push, 1)
+struct workload_record {
+  uint8_t type;
+  uint8_t op;
+  uint16_t name_len;
+  uint32_t payload_len;
+  uint64_t time_ns;
+};
+#pragma pack(pop)
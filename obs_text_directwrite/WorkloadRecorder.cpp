@@ -0,0 +1,61 @@
+#include "WorkloadRecorder.h"
+
+#include <obs-module.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/platform.h>
+
+#include <algorithm>
+
+using namespace std;
+
+atomic_bool WorkloadRecorder::enabled{false};
+mutex WorkloadRecorder::mutex;
+FILE *WorkloadRecorder::file = nullptr;
+uint64_t WorkloadRecorder::start_time = 0;
+
+void WorkloadRecorder::Start() {
+  const char *path = getenv(WORKLOAD_RECORD_ENV);
+  if (!path || !*path) return;
+
+  file = os_fopen(path, "wb");
+  if (!file) {
+    blog(LOG_WARNING, "[text_directwrite] cannot record workload to '%s'",
+         path);
+    return;
+  }
+
+  fwrite(WORKLOAD_MAGIC, 1, WORKLOAD_MAGIC_LEN, file);
+  start_time = os_gettime_ns();
+  enabled = true;
+
+  blog(LOG_INFO, "[text_directwrite] recording workload to '%s'", path);
+}
+
+void WorkloadRecorder::Stop() {
+  lock_guard<std::mutex> lock(mutex);
+
+  enabled = false;
+  if (file) fclose(file);
+  file = nullptr;
+}
+
+void WorkloadRecorder::Record(workload_event type, uint8_t op,
+                              const char *name, const void *payload,
+                              size_t len) {
+  if (!name) name = "";
+
+  workload_record record = {};
+  record.type = type;
+  record.op = op;
+  record.name_len = (uint16_t)min(strlen(name), (size_t)UINT16_MAX);
+  record.payload_len = (uint32_t)min(len, (size_t)UINT32_MAX);
+
+  lock_guard<std::mutex> lock(mutex);
+  if (!file) return;
+
+  record.time_ns = os_gettime_ns() - start_time;
+  fwrite(&record, sizeof(record), 1, file);
+  fwrite(name, 1, record.name_len, file);
+  fwrite(payload, 1, record.payload_len, file);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "WorkloadFormat.h"
+
+/* Module-wide recorder of source inputs.
+ *
+ * Recording is off unless the OBS_TEXT_DIRECTWRITE_RECORD environment
+ * variable names an output file when the module loads. Inputs of every
+ * source are appended to that one file under a lock, so a flood seen live
+ * can be replayed later against another build. */
+class WorkloadRecorder {
+ public:
+  static void Start();
+  static void Stop();
+
+  static inline bool Enabled() { return enabled; }
+  static void Record(workload_event type, uint8_t op, const char *name,
+                     const void *payload, size_t len);
+
+ private:
+  static std::atomic_bool enabled;
+  static std::mutex mutex;
+  static FILE *file;
+  static uint64_t start_time;
+};
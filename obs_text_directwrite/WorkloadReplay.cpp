@@ -0,0 +1,101 @@
+#include "WorkloadReplay.h"
+
+#include <obs-module.h>
+#include <stdio.h>
+#include <string.h>
+#include <util/platform.h>
+
+#include <algorithm>
+
+using namespace std;
+
+static const char *event_names[] = {"", "update", "file", "tick", "push"};
+
+WorkloadReplay::WorkloadReplay(const char *path_, const char *source_name,
+                               bool realtime_)
+    : path(path_ ? path_ : ""), realtime(realtime_) {
+  FILE *file = os_fopen(path.c_str(), "rb");
+  if (!file) return;
+
+  char magic[WORKLOAD_MAGIC_LEN];
+  if (fread(magic, 1, WORKLOAD_MAGIC_LEN, file) != WORKLOAD_MAGIC_LEN ||
+      memcmp(magic, WORKLOAD_MAGIC, WORKLOAD_MAGIC_LEN) != 0) {
+    fclose(file);
+    return;
+  }
+
+  /* without a name, the first source in the recording is played */
+  string filter = source_name ? source_name : "";
+  string name;
+
+  workload_record record;
+  while (fread(&record, sizeof(record), 1, file) == 1) {
+    name.resize(record.name_len);
+    WorkloadEvent event = {(workload_event)record.type, record.op,
+                           record.time_ns};
+    event.payload.resize(record.payload_len);
+
+    if ((record.name_len &&
+         fread(&name[0], 1, record.name_len, file) != record.name_len) ||
+        (record.payload_len &&
+         fread(&event.payload[0], 1, record.payload_len, file) !=
+             record.payload_len))
+      break;
+
+    if (record.type < WORKLOAD_UPDATE || record.type > WORKLOAD_PUSH)
+      continue;
+    if (filter.empty()) filter = name;
+    if (name != filter) continue;
+
+    events.push_back(move(event));
+  }
+
+  fclose(file);
+
+  if (!events.empty()) clock_ns = events.front().time_ns;
+  begin_ns = os_gettime_ns();
+}
+
+void WorkloadReplay::Advance(float seconds) {
+  if (realtime) clock_ns += (uint64_t)(seconds * 1000000000.0);
+}
+
+const WorkloadEvent *WorkloadReplay::Next() {
+  if (Finished()) return nullptr;
+  if (realtime && events[next].time_ns > clock_ns) return nullptr;
+
+  return &events[next++];
+}
+
+void WorkloadReplay::Applied(workload_event type, uint64_t start) {
+  open.push_back({type, start});
+}
+
+void WorkloadReplay::Rendered(uint64_t end) {
+  for (const Open &input : open)
+    latency[input.type].push_back(end - input.start);
+  open.clear();
+}
+
+void WorkloadReplay::Report(const char *source_name) const {
+  blog(LOG_INFO,
+       "[text_directwrite] '%s': replayed %zu events from '%s' in %.1f ms "
+       "(%s)",
+       source_name, events.size(), path.c_str(),
+       (os_gettime_ns() - begin_ns) / 1000000.0,
+       realtime ? "real time" : "as fast as possible");
+
+  for (int type = WORKLOAD_UPDATE; type <= WORKLOAD_PUSH; type++) {
+    vector<uint64_t> sorted = latency[type];
+    if (sorted.empty()) continue;
+    sort(sorted.begin(), sorted.end());
+
+    size_t count = sorted.size();
+    blog(LOG_INFO,
+         "[text_directwrite] '%s':   %-6s %zu events, latency p50 %.3f ms, "
+         "p95 %.3f ms, max %.3f ms",
+         source_name, event_names[type], count,
+         sorted[count / 2] / 1000000.0, sorted[count * 95 / 100] / 1000000.0,
+         sorted.back() / 1000000.0);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "WorkloadFormat.h"
+
+struct WorkloadEvent {
+  workload_event type;
+  uint8_t op;
+  uint64_t time_ns;
+  std::string payload;
+};
+
+/* Events of one recorded source, played back by a live source.
+ *
+ * Events are handed out in recorded order, either as fast as the caller
+ * asks for them or paced by the live tick clock. Inputs stay open until
+ * the next recorded tick renders them, so the latency of each input covers
+ * its application, any coalescing and the render that shows it. */
+class WorkloadReplay {
+ public:
+  WorkloadReplay(const char *path, const char *source_name, bool realtime);
+
+  inline bool Valid() const { return !events.empty(); }
+  inline bool Realtime() const { return realtime; }
+  inline bool Finished() const { return next >= events.size(); }
+
+  void Advance(float seconds);
+  const WorkloadEvent *Next();
+
+  void Applied(workload_event type, uint64_t start);
+  void Rendered(uint64_t end);
+
+  void Report(const char *source_name) const;
+
+ private:
+  struct Open {
+    workload_event type;
+    uint64_t start;
+  };
+
+  std::string path;
+  std::vector<WorkloadEvent> events;
+  size_t next = 0;
+  bool realtime;
+
+  uint64_t clock_ns = 0;
+  uint64_t begin_ns = 0;
+
+  std::vector<Open> open;
+  std::vector<uint64_t> latency[WORKLOAD_PUSH + 1];
+};
@@ -3,34 +3,12 @@
 void TextSource::CalculateGradientAxis(float width, float height) {
   if (width <= 0.f || height <= 0.f) return;
 
-  float angle = DEG(atan(height / width));
-
-  if (gradient_dir <= angle || gradient_dir > 360.f - angle) {
-    float y = width / 2.f * tan(RAD(gradient_dir));
-    gradient_x = width;
-    gradient_y = height / 2.f - y;
-    gradient2_x = 0.f;
-    gradient2_y = height / 2.f + y;
-
-  } else if (gradient_dir <= 180.f - angle && gradient_dir > angle) {
-    float x = height / 2.f * tan(RAD(90.f - gradient_dir));
-    gradient_x = width / 2.f + x;
-    gradient_y = 0.f;
-    gradient2_x = width / 2.f - x;
-    gradient2_y = height;
-  } else if (gradient_dir <= 180.f + angle && gradient_dir > 180.f - angle) {
-    float y = width / 2.f * tan(RAD(gradient_dir));
-    gradient_x = 0.f;
-    gradient_y = height / 2.f + y;
-    gradient2_x = width;
-    gradient2_y = height / 2.f - y;
-  } else {
-    float x = height / 2.f * tan(RAD(270.f - gradient_dir));
-    gradient_x = width / 2.f - x;
-    gradient_y = height;
-    gradient2_x = width / 2.f + x;
-    gradient2_y = 0.f;
-  }
+  float axis[4];
+  calculate_gradient_axis(gradient_dir, width, height, axis);
+  gradient_x = axis[0];
+  gradient_y = axis[1];
+  gradient2_x = axis[2];
+  gradient2_y = axis[3];
 }
 
 void TextSource::InitializeDirectWrite() {
@@ -51,7 +29,20 @@ void TextSource::InitializeDirectWrite() {
       D2D1_FEATURE_LEVEL_DEFAULT);
 }
 
+bool TextSource::PrepareResources() {
+  if (!pD2DFactory) InitializeDirectWrite();
+
+  if (font_dirty) {
+    font_dirty = false;
+    UpdateFont();
+  }
+
+  return pTextFormat != nullptr;
+}
+
 void TextSource::ReleaseResource() {
+  staging.Release();
+  run_cache.Clear();
   SafeRelease(&pTextFormat);
   SafeRelease(&pDWriteFactory);
   SafeRelease(&pD2DFactory);
@@ -105,6 +96,7 @@ void TextSource::UpdateBrush(ID2D1RenderTarget *pRT,
 }
 
 void TextSource::RenderText() {
+  TRACE_SCOPE("RenderText", obs_source_get_name(source));
   UINT32 TextLength = (UINT32)wcslen(text.c_str());
 
   float layout_cx = (use_extents) ? extents_cx : 1920.f;
@@ -112,17 +104,27 @@ void TextSource::RenderText() {
   float text_cx = 0.f;
   float text_cy = 0.f;
 
+  /* a marquee keeps the whole string on one line along the scroll axis */
+  if (marquee) {
+    if (vertical)
+      layout_cy = MAX_MARQUEE_SIZE;
+    else
+      layout_cx = MAX_MARQUEE_SIZE;
+  }
+
   SIZE size;
+  SIZE view;
   UINT32 lines = 1;
+  float scale = 1.f;
 
   IDWriteTextLayout *pTextLayout = nullptr;
-  ID2D1Brush *pFillBrush = nullptr;
-  ID2D1Brush *pOutlineBrush = nullptr;
-  ID2D1DCRenderTarget *pRT = nullptr;
 
   HRESULT hr =
       pDWriteFactory->CreateTextLayout(text.c_str(), TextLength, pTextFormat,
                                        layout_cx, layout_cy, &pTextLayout);
+  if (SUCCEEDED(hr) && marquee) {
+    hr = pTextLayout->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+  }
   if (SUCCEEDED(hr)) {
     DWRITE_TEXT_METRICS textMetrics;
     hr = pTextLayout->GetMetrics(&textMetrics);
@@ -131,16 +133,48 @@ void TextSource::RenderText() {
     text_cy = ceil(textMetrics.height);
     lines = textMetrics.lineCount;
 
-    if (!use_extents) {
-      layout_cx = text_cx;
-      layout_cy = text_cy;
+    /* beyond MAX_MARQUEE_SIZE the end of the string is not rendered */
+    bool clipped = marquee && (vertical ? text_cy : text_cx) > MAX_MARQUEE_SIZE;
+    if (clipped && !marquee_clipped)
+      blog(LOG_WARNING,
+           "[text_directwrite] '%s': marquee text is %.0f pixels long, "
+           "only the first %.0f are shown",
+           obs_source_get_name(source), vertical ? text_cy : text_cx,
+           MAX_MARQUEE_SIZE);
+    marquee_clipped = clipped;
+
+    float view_cx = (use_extents) ? extents_cx : text_cx;
+    float view_cy = (use_extents) ? extents_cy : text_cy;
+    clamp(view_cx, MIN_SIZE_CX, MAX_SIZE_CX);
+    clamp(view_cy, MIN_SIZE_CY, MAX_SIZE_CY);
+
+    if (marquee) {
+      if (vertical) {
+        layout_cy = text_cy;
+        clamp(layout_cy, MIN_SIZE_CY, MAX_MARQUEE_SIZE);
+      } else {
+        layout_cx = text_cx;
+        clamp(layout_cx, MIN_SIZE_CX, MAX_MARQUEE_SIZE);
+      }
+    } else {
+      layout_cx = view_cx;
+      layout_cy = view_cy;
     }
 
-    clamp(layout_cx, MIN_SIZE_CX, MAX_SIZE_CX);
-    clamp(layout_cy, MIN_SIZE_CY, MAX_SIZE_CY);
+    /* layout stays in source units, only the raster follows the scene
+     * scale. a marquee scrolls in texture pixels and is never scaled. */
+    if (!marquee) {
+      scale = raster_scale;
+      if (layout_cx * scale > MAX_SIZE_CX)
+        scale = float(MAX_SIZE_CX / layout_cx);
+      if (layout_cy * scale > MAX_SIZE_CY)
+        scale = float(MAX_SIZE_CY / layout_cy);
+    }
 
-    size.cx = layout_cx;
-    size.cy = layout_cy;
+    size.cx = (LONG)ceil(layout_cx * scale);
+    size.cy = (LONG)ceil(layout_cy * scale);
+    view.cx = view_cx;
+    view.cy = view_cy;
   }
   if (SUCCEEDED(hr)) {
     DWRITE_TEXT_RANGE text_range = {0, TextLength};
@@ -152,89 +186,822 @@ void TextSource::RenderText() {
       pTextLayout->SetReadingDirection(DWRITE_READING_DIRECTION_TOP_TO_BOTTOM);
       pTextLayout->SetFlowDirection(DWRITE_FLOW_DIRECTION_RIGHT_TO_LEFT);
     }
-
-    hr = pD2DFactory->CreateDCRenderTarget(&props, &pRT);
   }
   if (SUCCEEDED(hr)) {
-    obs_enter_graphics();
-    RECT rc;
-    SetRect(&rc, 0, 0, size.cx, size.cy);
-    if (!tex || (LONG)cx != size.cx || (LONG)cy != size.cy) {
-      if (tex) {
-        gs_texture_destroy(tex);
+    shared_ptr<RenderOutput> next = make_shared<RenderOutput>();
+
+    /* a marquee longer than one texture is split along its scroll axis */
+    LONG length = vertical ? size.cy : size.cx;
+    size_t tiles = 1;
+    if (marquee)
+      tiles = (size_t)(length + MARQUEE_TILE_SIZE - 1) / MARQUEE_TILE_SIZE;
+
+    /* the texture is only ever drawn on this thread, so an unchanged size
+     * lets the next output redraw it in place, as long as nothing else holds
+     * the current output: an output adopted by identical sources, or read
+     * back by SaveImage, keeps its texture untouched. */
+    shared_ptr<gs_texture_t> reuse;
+    if (tiles == 1 && output && output.use_count() == 1 &&
+        output->tiles.empty() && (LONG)output->tex_cx == size.cx &&
+        (LONG)output->tex_cy == size.cy)
+      reuse = output->tex;
+
+    bool staged = false;
+    for (size_t i = 0; i < tiles; i++) {
+      LONG offset = (LONG)i * MARQUEE_TILE_SIZE;
+      LONG cx = size.cx;
+      LONG cy = size.cy;
+      D2D1_POINT_2F origin = D2D1::Point2F();
+      if (vertical && tiles > 1) {
+        cy = min(cy - offset, (LONG)MARQUEE_TILE_SIZE);
+        origin.y = (FLOAT)offset;
+      } else if (tiles > 1) {
+        cx = min(cx - offset, (LONG)MARQUEE_TILE_SIZE);
+        origin.x = (FLOAT)offset;
       }
-      tex = gs_texture_create_gdi(size.cx, size.cy);
+
+      shared_ptr<gs_texture_t> tex = RasterizeTile(
+          pTextLayout, scale, text_cx, text_cy / lines, cx, cy, origin, reuse,
+          output && output->dynamic, staged);
+      if (i == 0)
+        next->tex = move(tex);
+      else
+        next->tiles.push_back(move(tex));
     }
-    HDC hdc = (HDC)gs_texture_get_dc(tex);
-    if (hdc) {
-      pRT->BindDC(hdc, &rc);
 
-      UpdateBrush(pRT, &pOutlineBrush, &pFillBrush, text_cx, text_cy / lines);
+    next->dynamic = staged;
+    next->tex_cx = (uint32_t)size.cx;
+    next->tex_cy = (uint32_t)size.cy;
+    next->cx = (uint32_t)view.cx;
+    next->cy = (uint32_t)view.cy;
+    next->scale = scale;
+    if (effect != EFFECT_NONE && !marquee && !vertical)
+      MeasureLines(pTextLayout, scale, *next);
+    atomic_store(&output, shared_ptr<const RenderOutput>(next));
+
+    float length = float(vertical ? next->tex_cy : next->tex_cx);
+    marquee_offset = fmodf(marquee_offset, length);
+  }
 
-      const auto &pTextRenderer = new CustomTextRenderer(
-          pD2DFactory, pDWriteFactory, (ID2D1RenderTarget *)pRT,
-          (ID2D1Brush *)pOutlineBrush, (ID2D1Brush *)pFillBrush, outline_size,
-          vertical);
-      if (pTextRenderer) {
-        pRT->BeginDraw();
+  SafeRelease(&pTextLayout);
+}
 
-        pRT->SetTransform(D2D1::IdentityMatrix());
+/* rasterizes cx by cy pixels of the layout from origin on. the staging
+ * bitmap is drawn before taking the graphics lock, a GDI-compatible texture
+ * is the fallback when that is unavailable. */
+shared_ptr<gs_texture_t> TextSource::RasterizeTile(
+    IDWriteTextLayout *pTextLayout, float scale, float text_cx, float line_cy,
+    LONG cx, LONG cy, const D2D1_POINT_2F &origin,
+    const shared_ptr<gs_texture_t> &reuse, bool reuse_dynamic, bool &staged) {
+  ID2D1DCRenderTarget *pRT = nullptr;
+  shared_ptr<gs_texture_t> tex;
 
-        pRT->Clear(D2D1::ColorF(bk_color, bk_opacity / 100.f));
+  staged = !gdi_upload && staging.Prepare(pD2DFactory, cx, cy) &&
+           SUCCEEDED(DrawLayout(staging.Target(), pTextLayout, scale, text_cx,
+                                line_cy, D2D1::ColorF(0, 0.f), origin));
+  if (reuse_dynamic == staged) tex = reuse;
 
-        hr = pTextLayout->Draw(nullptr, pTextRenderer, 0.f, 0.f);
+  uint64_t start = os_gettime_ns();
+  {
+    TRACE_SCOPE("obs_enter_graphics", obs_source_get_name(source));
+    obs_enter_graphics();
+  }
+  if (staged) {
+    TRACE_SCOPE("Upload", obs_source_get_name(source));
+    if (!tex)
+      tex = make_texture(
+          gs_texture_create(cx, cy, GS_BGRA, 1, nullptr, GS_DYNAMIC));
+
+    if (!staging.Upload(tex.get(), premultiply_color(bk_color, bk_opacity))) {
+      blog(LOG_WARNING,
+           "[text_directwrite] '%s': cannot map dynamic texture, "
+           "uploading through GDI surfaces",
+           obs_source_get_name(source));
+      gdi_upload = true;
+      staging.Release();
+      tex = nullptr;
+      staged = false;
+    }
+  }
+  if (!staged) {
+    RECT rc;
+    SetRect(&rc, 0, 0, cx, cy);
+    if (!tex) tex = make_texture(gs_texture_create_gdi(cx, cy));
+    HDC hdc = tex ? (HDC)gs_texture_get_dc(tex.get()) : nullptr;
+    if (hdc && SUCCEEDED(pD2DFactory->CreateDCRenderTarget(&props, &pRT))) {
+      pRT->BindDC(hdc, &rc);
+      DrawLayout(pRT, pTextLayout, scale, text_cx, line_cy,
+                 D2D1::ColorF(bk_color, bk_opacity / 100.f), origin);
+    }
+    if (hdc) gs_texture_release_dc(tex.get());
+  }
+  obs_leave_graphics();
+  stat_graphics_ns += os_gettime_ns() - start;
+  stat_uploads++;
 
-        hr = pRT->EndDraw();
-      }
-      gs_texture_release_dc(tex);
+  SafeRelease(&pRT);
+  return tex;
+}
+
+/* records the line boxes and the right edge of every character's cluster in
+ * texture pixels. clusters are summed from the start of their line in
+ * logical order, which places them correctly for left-to-right text only;
+ * right-to-left text records nothing and is drawn without the effect. */
+void TextSource::MeasureLines(IDWriteTextLayout *pTextLayout, float scale,
+                              RenderOutput &out) {
+  UINT32 line_count = 0;
+  UINT32 cluster_count = 0;
+  pTextLayout->GetLineMetrics(nullptr, 0, &line_count);
+  pTextLayout->GetClusterMetrics(nullptr, 0, &cluster_count);
+
+  pmr::vector<DWRITE_LINE_METRICS> lines(line_count, arena.Resource());
+  pmr::vector<DWRITE_CLUSTER_METRICS> clusters(cluster_count,
+                                               arena.Resource());
+  if (FAILED(pTextLayout->GetLineMetrics(lines.data(), line_count,
+                                         &line_count)) ||
+      FAILED(pTextLayout->GetClusterMetrics(clusters.data(), cluster_count,
+                                            &cluster_count)))
+    return;
+
+  if (pTextLayout->GetReadingDirection() ==
+      DWRITE_READING_DIRECTION_RIGHT_TO_LEFT)
+    return;
+  for (const DWRITE_CLUSTER_METRICS &metrics : clusters)
+    if (metrics.isRightToLeft) return;
+
+  out.lines.reserve(line_count);
+  out.char_right.assign(text.size(), 0.f);
+
+  uint32_t pos = 0;
+  size_t cluster = 0;
+  for (const DWRITE_LINE_METRICS &metrics : lines) {
+    FLOAT x, y;
+    DWRITE_HIT_TEST_METRICS hit;
+    if (FAILED(pTextLayout->HitTestTextPosition(pos, FALSE, &x, &y, &hit)))
+      break;
+
+    TextLine line;
+    line.top = hit.top * scale;
+    line.bottom = (hit.top + metrics.height) * scale;
+    line.first = pos;
+    line.end = min(pos + metrics.length, (uint32_t)out.char_right.size());
+
+    float right = hit.left;
+    while (pos < line.end && cluster < clusters.size()) {
+      right += clusters[cluster].width;
+      for (UINT16 i = 0; i < clusters[cluster].length && pos < line.end; i++)
+        out.char_right[pos++] = right * scale;
+      cluster++;
     }
-    obs_leave_graphics();
 
-    cx = (uint32_t)size.cx;
-    cy = (uint32_t)size.cy;
+    pos = line.end;
+    out.lines.push_back(line);
   }
+}
+
+HRESULT TextSource::DrawLayout(ID2D1RenderTarget *pRT,
+                               IDWriteTextLayout *pTextLayout, float scale,
+                               float text_cx, float line_cy,
+                               const D2D1_COLOR_F &background,
+                               const D2D1_POINT_2F &origin) {
+  TRACE_SCOPE("DrawLayout", obs_source_get_name(source));
+  ID2D1Brush *pFillBrush = nullptr;
+  ID2D1Brush *pOutlineBrush = nullptr;
+  HRESULT hr = E_FAIL;
+
+  UpdateBrush(pRT, &pOutlineBrush, &pFillBrush, text_cx, line_cy);
+
+  IDWriteTextRenderer1 *pTextRenderer = CreateTextRenderer(
+      pD2DFactory, pDWriteFactory, pRT, pOutlineBrush, pFillBrush,
+      outline_size, vertical, &run_cache);
+  if (pTextRenderer) {
+    pRT->BeginDraw();
+
+    /* brushes are placed in layout units, so they move with the tile */
+    pRT->SetTransform(D2D1::Matrix3x2F::Scale(scale, scale) *
+                      D2D1::Matrix3x2F::Translation(-origin.x, -origin.y));
+
+    pRT->Clear(background);
 
+    hr = pTextLayout->Draw(nullptr, pTextRenderer, 0.f, 0.f);
+
+    hr = pRT->EndDraw();
+  }
+
+  SafeRelease(&pTextRenderer);
   SafeRelease(&pFillBrush);
   SafeRelease(&pOutlineBrush);
-  SafeRelease(&pTextLayout);
-  SafeRelease(&pRT);
+  run_cache.EndRender();
+  return hr;
+}
+
+template <class T>
+static inline void key_append(pmr::string &key, const T &value) {
+  key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static inline void key_append(pmr::string &key, const wstring &value) {
+  key_append(key, value.size());
+  key.append(reinterpret_cast<const char *>(value.data()),
+             value.size() * sizeof(wchar_t));
+}
+
+pmr::string TextSource::RenderKey() {
+  pmr::string key(arena.Resource());
+  key.reserve(text.size() * sizeof(wchar_t) + 256);
+
+  key_append(key, text);
+  key_append(key, face);
+  key_append(key, font_generation);
+  key_append(key, locale);
+  key_append(key, face_size);
+  key_append(key, bold);
+  key_append(key, italic);
+  key_append(key, underline);
+  key_append(key, strikeout);
+  key_append(key, vertical);
+  key_append(key, align);
+  key_append(key, valign);
+  key_append(key, wrap);
+  key_append(key, color);
+  key_append(key, color2);
+  key_append(key, color3);
+  key_append(key, color4);
+  key_append(key, opacity);
+  key_append(key, opacity2);
+  key_append(key, gradient_count);
+  key_append(key, gradient_dir);
+  key_append(key, bk_color);
+  key_append(key, bk_opacity);
+  key_append(key, use_outline);
+  key_append(key, outline_size);
+  key_append(key, outline_color);
+  key_append(key, outline_opacity);
+  key_append(key, use_extents);
+  key_append(key, extents_cx);
+  key_append(key, extents_cy);
+  key_append(key, chatlog_mode);
+  key_append(key, chatlog_lines);
+  key_append(key, marquee);
+  key_append(key, effect != EFFECT_NONE);
+  key_append(key, raster_scale);
+
+  return key;
+}
+
+template <class T>
+static void index_lines(const T *data, size_t len, vector<size_t> &index) {
+  index.clear();
+  index.push_back(0);
+  for (size_t i = 0; i + 1 < len; i++) {
+    if (data[i] == '\n') index.push_back(i + 1);
+  }
+}
+
+template <class T>
+static size_t trim_line_end(const T *data, size_t begin, size_t end) {
+  while (end > begin && (data[end - 1] == '\n' || data[end - 1] == '\r'))
+    end--;
+  return end;
 }
 
 const char *TextSource::GetMainString(const char *str) {
   if (!str) return "";
   if (!chatlog_mode || !chatlog_lines) return str;
 
-  int lines = chatlog_lines;
-  size_t len = strlen(str);
-  if (!len) return str;
+  return chatlog_tail(str, strlen(str), chatlog_lines);
+}
+
+/* chatlog_tail counts paragraphs, but with wrapping a single long message
+ * can fill the whole box. lay out paragraphs from the end and keep only as
+ * many as fit in chatlog_lines visual lines, stopping as soon as the budget
+ * is used up so older messages are never shaped. */
+void TextSource::TrimVisualLines() {
+  TRACE_SCOPE("TrimVisualLines", obs_source_get_name(source));
+  if (!chatlog_mode || chatlog_lines <= 0 || !use_extents || !wrap ||
+      marquee || text.empty())
+    return;
 
-  const char *temp = str + len;
+  const wchar_t *data = text.c_str();
+  size_t para_end = text.size();
+  if (data[para_end - 1] == '\n') para_end--;
 
-  while (temp != str) {
-    temp--;
+  int budget = chatlog_lines;
+  size_t keep = 0;
+  pmr::vector<DWRITE_LINE_METRICS> metrics(arena.Resource());
 
-    if (temp[0] == '\n' && temp[1] != 0) {
-      if (!--lines) break;
+  for (;;) {
+    size_t para_begin = para_end;
+    while (para_begin && data[para_begin - 1] != '\n') para_begin--;
+
+    size_t len = trim_line_end(data, para_begin, para_end) - para_begin;
+
+    IDWriteTextLayout *pTextLayout = nullptr;
+    DWRITE_TEXT_METRICS textMetrics;
+    UINT32 count = 1;
+    if (SUCCEEDED(pDWriteFactory->CreateTextLayout(
+            data + para_begin, (UINT32)len, pTextFormat, extents_cx,
+            extents_cy, &pTextLayout)) &&
+        SUCCEEDED(pTextLayout->GetMetrics(&textMetrics))) {
+      count = max(textMetrics.lineCount, 1U);
     }
+
+    if ((int)count >= budget) {
+      /* cut inside the paragraph at the first line that still fits */
+      size_t cut = para_begin;
+      metrics.resize(count);
+      if (pTextLayout && (int)count > budget &&
+          SUCCEEDED(pTextLayout->GetLineMetrics(metrics.data(), count,
+                                                &count))) {
+        for (UINT32 i = 0; i + budget < count; i++) cut += metrics[i].length;
+      }
+      SafeRelease(&pTextLayout);
+      keep = cut;
+      break;
+    }
+    SafeRelease(&pTextLayout);
+
+    budget -= (int)count;
+    keep = para_begin;
+    if (!para_begin) break;
+    para_end = para_begin - 1;
   }
 
-  return *temp == '\n' ? temp + 1 : temp;
+  if (keep) text.erase(0, keep);
 }
 
 void TextSource::LoadFileText() {
-  BPtr<char> file_text = os_quick_read_utf8_file(file.c_str());
-  text = to_wide(GetMainString(file_text));
+  TRACE_SCOPE("LoadFileText", obs_source_get_name(source));
+  MappedFile mapped(file.c_str());
+
+  /* editors and tools touch files without changing them */
+  size_t bytes = mapped.Length() * (mapped.IsUtf16() ? sizeof(wchar_t) : 1);
+  uint64_t hash = ContentHash::Hash(mapped.Data(), bytes);
+  if (hash == file_hash) {
+    stat_file_unchanged++;
+    return;
+  }
+  file_hash = hash;
+
+  if (IsVirtual()) {
+    IndexFileLines(mapped);
+    mapped.Close();
+    return;
+  }
+
+  line_index.clear();
+
+  LoadText(mapped.Data(), mapped.Length(), mapped.IsUtf16());
+
+  if (Recording())
+    WorkloadRecorder::Record(WORKLOAD_FILE, mapped.IsUtf16(),
+                             obs_source_get_name(source), mapped.Data(),
+                             bytes);
+  mapped.Close();
+}
+
+/* len is in code units of the encoding */
+void TextSource::LoadText(const char *data, size_t len, bool utf16) {
+  /* only the part that will be shown is converted */
+  int lines = chatlog_mode ? chatlog_lines : 0;
+
+  if (utf16) {
+    const wchar_t *wide = reinterpret_cast<const wchar_t *>(data);
+    const wchar_t *tail = lines ? chatlog_tail(wide, len, lines) : wide;
+    text.assign(tail, wide + len);
+  } else {
+    const char *tail = lines ? chatlog_tail(data, len, lines) : data;
+    text = to_wide(tail, len - (tail - data));
+  }
+}
+
+void TextSource::IndexFileLines(const MappedFile &mapped) {
+  file_length = mapped.Length();
+  file_utf16 = mapped.IsUtf16();
+
+  if (file_utf16)
+    index_lines(mapped.Wide(), file_length, line_index);
+  else
+    index_lines(mapped.Data(), file_length, line_index);
+
+  window_dirty = true;
+}
+
+void TextSource::ExtractWindow() {
+  TRACE_SCOPE("ExtractWindow", obs_source_get_name(source));
+  /* a window move only reads the lines it shows. the index follows the
+   * file through the modification poll in Tick and the content hash in
+   * LoadFileText; a change the poll has not seen yet only clamps the window
+   * to what the file holds now. */
+  MappedFile mapped(file.c_str());
+  window_dirty = false;
+
+  if (!mapped.Valid() || line_index.empty() ||
+      mapped.IsUtf16() != file_utf16) {
+    text.clear();
+    return;
+  }
+  size_t length = min(file_length, mapped.Length());
+
+  /* every line takes at least one line of height, so this many lines
+   * always fill the view, plus a small margin for partially visible ones */
+  float view = vertical ? (use_extents ? extents_cx : 1920.f)
+                        : (use_extents ? extents_cy : 1080.f);
+  size_t count = (size_t)ceilf(view / max(line_height, 1.f)) + 2;
+
+  size_t first = (size_t)scroll_pos % line_index.size();
+  size_t last = min(first + count, line_index.size());
+  size_t begin = min(line_index[first], length);
+  size_t end = last < line_index.size() ? line_index[last] : file_length;
+  end = min(end, length);
+
+  if (file_utf16) {
+    const wchar_t *data = mapped.Wide();
+    text.assign(data + begin, data + trim_line_end(data, begin, end));
+  } else {
+    const char *data = mapped.Data();
+    end = trim_line_end(data, begin, end);
+    text = to_wide(data + begin, end - begin);
+  }
+  mapped.Close();
+}
+
+static void proc_save_image(void *data, calldata_t *cd) {
+  calldata_set_bool(cd, "success",
+                    reinterpret_cast<TextSource *>(data)->SaveImage(
+                        calldata_string(cd, "path")));
+}
+
+static void proc_replay_workload(void *data, calldata_t *cd) {
+  reinterpret_cast<TextSource *>(data)->StartReplay(
+      calldata_string(cd, "path"), calldata_string(cd, "source"),
+      calldata_bool(cd, "realtime"));
+}
+
+template <push_op op>
+static void proc_push_text(void *data, calldata_t *cd) {
+  const char *str = calldata_string(cd, "text");
+  if (!str) str = "";
+
+  reinterpret_cast<TextSource *>(data)->PushText(op, str, strlen(str));
+}
+
+/* procedures for scripts and other plugins, they skip the settings
+ * round-trip and go through the same coalesced path as the push pipe */
+void TextSource::RegisterProcs() {
+  proc_handler_t *ph = obs_source_get_proc_handler(source);
+
+  proc_handler_add(ph, "void set_text(in string text)",
+                   proc_push_text<PUSH_REPLACE>, this);
+  proc_handler_add(ph, "void append_text(in string text)",
+                   proc_push_text<PUSH_APPEND>, this);
+  proc_handler_add(ph, "void append_line(in string text)",
+                   proc_push_text<PUSH_APPEND_LINE>, this);
+  proc_handler_add(ph, "void clear()", proc_push_text<PUSH_CLEAR>, this);
+  proc_handler_add(ph,
+                   "void replay_workload(in string path, in string source, "
+                   "in bool realtime)",
+                   proc_replay_workload, this);
+  proc_handler_add(ph, "void save_image(in string path, out bool success)",
+                   proc_save_image, this);
+}
+
+void TextSource::PushText(push_op op, const char *str, size_t len) {
+  if (Recording())
+    WorkloadRecorder::Record(WORKLOAD_PUSH, op, obs_source_get_name(source),
+                             str, len);
+
+  lock_guard<mutex> lock(push_mutex);
+  push_merge(push_text, push_reset, op, str, len);
+
+  if (push_pending.exchange(true)) stat_coalesced++;
+}
+
+void TextSource::ApplyPushedText() {
+  string pushed;
+  bool reset;
+  {
+    lock_guard<mutex> lock(push_mutex);
+    pushed.swap(push_text);
+    reset = push_reset;
+    push_reset = false;
+    push_pending = false;
+  }
+
+  if (read_from_file) return;
+
+  if (reset)
+    raw_text.swap(pushed);
+  else
+    raw_text += pushed;
+
+  /* appends only ever show the tail in chatlog mode, drop the rest */
+  const char *tail = GetMainString(raw_text.c_str());
+  raw_text.erase(0, tail - raw_text.c_str());
+
+  text = to_wide(raw_text.c_str(), raw_text.size());
+  RequestRender();
+}
+
+void TextSource::StartReplay(const char *path, const char *name,
+                             bool realtime) {
+  unique_ptr<WorkloadReplay> next =
+      make_unique<WorkloadReplay>(path, name, realtime);
+  if (!next->Valid()) {
+    blog(LOG_WARNING, "[text_directwrite] '%s': no workload to replay in '%s'",
+         obs_source_get_name(source), path ? path : "");
+    return;
+  }
+
+  lock_guard<mutex> lock(replay_mutex);
+  replay_pending = move(next);
+}
+
+/* recorded inputs go through the same paths as live ones, except that file
+ * content is loaded from the recording instead of the recorded path. a fast
+ * replay runs in slices so the video thread still makes progress. */
+bool TextSource::StepReplay(float seconds) {
+  {
+    lock_guard<mutex> lock(replay_mutex);
+    if (replay_pending) replay = move(replay_pending);
+  }
+  if (!replay) return false;
+  replaying = true;
+
+  uint64_t deadline = os_gettime_ns() + REPLAY_SLICE_NS;
+  replay->Advance(seconds);
+
+  while (const WorkloadEvent *event = replay->Next()) {
+    uint64_t start = os_gettime_ns();
+
+    switch (event->type) {
+      case WORKLOAD_UPDATE: {
+        /* only values the user changed are recorded, the defaults are
+         * applied underneath them as obs does for a live source */
+        obs_data_t *data = obs_data_create_from_json(event->payload.c_str());
+        if (data) {
+          obs_data_t *settings = obs_get_source_defaults(TEXT_SOURCE_ID);
+          obs_data_apply(settings, data);
+          Update(settings);
+          obs_data_release(settings);
+          obs_data_release(data);
+
+          applied_settings = atomic_load(&pending_settings);
+          ApplySettings(*applied_settings);
+          file_changed = false;
+        }
+        break;
+      }
+      case WORKLOAD_FILE: {
+        size_t unit = event->op ? sizeof(wchar_t) : 1;
+        LoadText(event->payload.data(), event->payload.size() / unit,
+                 !!event->op);
+        RequestRender();
+        break;
+      }
+      case WORKLOAD_PUSH:
+        PushText((push_op)event->op, event->payload.data(),
+                 event->payload.size());
+        ApplyPushedText();
+        break;
+      case WORKLOAD_TICK:
+        if (render_pending) FlushRender(!replay->Realtime());
+        break;
+    }
+
+    replay->Applied(event->type, start);
+    if (event->type == WORKLOAD_TICK) replay->Rendered(os_gettime_ns());
+
+    if (!replay->Realtime() && os_gettime_ns() >= deadline) break;
+  }
+
+  if (replay->Finished()) {
+    replay->Report(obs_source_get_name(source));
+    replay.reset();
+    replaying = false;
+
+    /* back to the source's own settings */
+    obs_source_update(source, nullptr);
+  }
+  return true;
+}
+
+/* reads the current texture back so renders can be compared against stored
+ * images; callable from any thread */
+bool TextSource::SaveImage(const char *path) {
+  shared_ptr<const RenderOutput> out = atomic_load(&output);
+  if (!path || !*path || !out || !out->tex) return false;
+
+  uint32_t cx = out->tex_cx;
+  uint32_t cy = out->tex_cy;
+  vector<uint8_t> pixels((size_t)cx * cy * 4);
+  bool read = true;
+
+  /* the tiles of a long marquee are stitched back into one image */
+  obs_enter_graphics();
+  for (size_t i = 0; read && i < out->TileCount(); i++) {
+    uint32_t offset = (uint32_t)i * MARQUEE_TILE_SIZE;
+    uint32_t x = 0, y = 0, tile_cx = cx, tile_cy = cy;
+    if (!out->tiles.empty() && out->TiledDown()) {
+      y = offset;
+      tile_cy = min(cy - offset, (uint32_t)MARQUEE_TILE_SIZE);
+    } else if (!out->tiles.empty()) {
+      x = offset;
+      tile_cx = min(cx - offset, (uint32_t)MARQUEE_TILE_SIZE);
+    }
+
+    gs_stagesurf_t *stage = gs_stagesurface_create(tile_cx, tile_cy, GS_BGRA);
+    uint8_t *data = nullptr;
+    uint32_t linesize = 0;
+    read = false;
+    if (stage) {
+      gs_stage_texture(stage, out->Tile(i));
+      if (gs_stagesurface_map(stage, &data, &linesize)) {
+        for (uint32_t row = 0; row < tile_cy; row++)
+          memcpy(&pixels[((size_t)(y + row) * cx + x) * 4],
+                 data + (size_t)row * linesize, (size_t)tile_cx * 4);
+        gs_stagesurface_unmap(stage);
+        read = true;
+      }
+      gs_stagesurface_destroy(stage);
+    }
+  }
+  obs_leave_graphics();
+
+  return read && StagingTarget::SavePng(to_wide(path).c_str(), pixels.data(),
+                                        cx, cy, cx * 4);
+}
+
+void TextSource::RequestRender() {
+  if (render_pending.exchange(true)) stat_coalesced++;
+}
+
+void TextSource::FlushRender(bool catch_up) {
+  /* a source that just became visible must be current when it is drawn */
+  if (!catch_up) {
+    if (max_render_rate && render_time_elapsed < 1.f / max_render_rate) {
+      stat_rate_limited++;
+      return;
+    }
+    if (!RenderScheduler::Acquire(render_frames_waited)) {
+      render_frames_waited++;
+      stat_over_budget++;
+      return;
+    }
+  }
+
+  TRACE_SCOPE("FlushRender", obs_source_get_name(source));
+  render_pending = false;
+  render_frames_waited = 0;
+  render_time_elapsed = 0.f;
+
+  uint64_t start = os_gettime_ns();
+  if (file_changed) {
+    file_changed = false;
+    LoadFileText();
+  }
+  if (PrepareResources()) {
+    if (window_dirty && IsVirtual()) ExtractWindow();
+
+    /* the key is taken before trimming. trimming reads only the text and
+     * settings in the key (chatlog limits, extents, wrap, marquee and the
+     * font), so equal keys trim alike. text already trimmed by the last
+     * render matches that render's trimmed key instead. */
+    pmr::string key = RenderKey();
+    uint64_t hash = ContentHash::Hash(key.data(), key.size());
+
+    if (output && output->tex &&
+        (hash == rendered_hash || hash == trimmed_hash)) {
+      stat_unchanged++;
+    } else {
+      size_t length = text.size();
+      TrimVisualLines();
+
+      /* identical sources share one output instead of rendering it again.
+       * the previous output is only compared by address, a second strong
+       * reference here would keep RenderText from reusing its texture. */
+      const RenderOutput *previous = output.get();
+      shared_ptr<const RenderOutput> shared = TextureCache::Find(hash, key);
+      if (shared) {
+        if (shared != output) stat_shared++;
+        atomic_store(&output, shared);
+      } else {
+        RenderText();
+        if (output && output.get() != previous)
+          TextureCache::Insert(hash, key, output);
+      }
+
+      if (output.get() != previous) {
+        StartEffect();
+        rendered_hash = hash;
+        trimmed_hash = hash;
+        if (text.size() != length) {
+          pmr::string trimmed = RenderKey();
+          trimmed_hash = ContentHash::Hash(trimmed.data(), trimmed.size());
+        }
+      }
+    }
+  }
+  arena.Reset();
+  RenderScheduler::Release(os_gettime_ns() - start);
+
+  stat_renders++;
+}
+
+MemoryUsage TextSource::GetMemoryUsage() const {
+  MemoryUsage usage;
+  usage.cpu = staging.Bytes() + sizeof(arena) + run_cache.MemoryBytes() +
+              effect_text.capacity() * sizeof(wchar_t) +
+              text.capacity() * sizeof(wchar_t) + raw_text.capacity() +
+              line_index.capacity() * sizeof(size_t);
+
+  shared_ptr<const RenderOutput> out = atomic_load(&output);
+  if (out && out->tex) {
+    usage.gpu = (size_t)out->tex_cx * out->tex_cy * 4;
+    usage.gpu_owner = out->tex.get();
+  }
+  return usage;
+}
+
+/* the staging bitmap and run outlines are rebuilt on the next render. a
+ * hidden source also gives up its texture but keeps its size, and renders
+ * again when shown. */
+size_t TextSource::ReleaseMemory(bool active) {
+  size_t freed = staging.Bytes() + run_cache.MemoryBytes();
+  staging.Release();
+  run_cache.Clear();
+
+  if (!active && output && output->tex) {
+    if (output.use_count() == 1)
+      freed += (size_t)output->tex_cx * output->tex_cy * 4;
+
+    shared_ptr<RenderOutput> next = make_shared<RenderOutput>(*output);
+    next->tex = nullptr;
+    next->tiles.clear();
+    atomic_store(&output, shared_ptr<const RenderOutput>(next));
+    RequestRender();
+  }
+  return freed;
+}
+
+void TextSource::LogRenderStats() {
+  if (!stat_renders) return;
+
+  blog(LOG_INFO,
+       "[text_directwrite] '%s': %llu renders, %llu updates coalesced, "
+       "%llu frames held by rate limit, %llu frames held by frame budget, "
+       "%llu outputs shared with identical sources",
+       obs_source_get_name(source), (unsigned long long)stat_renders,
+       (unsigned long long)stat_coalesced.load(),
+       (unsigned long long)stat_rate_limited,
+       (unsigned long long)stat_over_budget,
+       (unsigned long long)stat_shared);
+
+  if (stat_uploads)
+    blog(LOG_INFO,
+         "[text_directwrite] '%s': %llu uploads, %.3f ms average in the "
+         "graphics context (%s)",
+         obs_source_get_name(source), (unsigned long long)stat_uploads,
+         stat_graphics_ns / 1000000.0 / stat_uploads,
+         gdi_upload ? "GDI surface" : "mapped dynamic texture");
+
+  if (stat_unchanged || stat_file_unchanged)
+    blog(LOG_INFO,
+         "[text_directwrite] '%s': %llu renders avoided for unchanged "
+         "content, %llu file reloads with identical content",
+         obs_source_get_name(source), (unsigned long long)stat_unchanged,
+         (unsigned long long)stat_file_unchanged);
+
+  arena.LogStats(obs_source_get_name(source));
+  run_cache.LogStats(obs_source_get_name(source));
 }
 
 void TextSource::UpdateFont() {
   SafeRelease(&pTextFormat);
 
   if (pDWriteFactory) {
+    font_generation = FontCache::Generation();
+    FontResolution font = FontCache::Resolve(face);
+    if (bold && font.weight < DWRITE_FONT_WEIGHT_BOLD)
+      font.weight = DWRITE_FONT_WEIGHT_BOLD;
+    if (italic) font.style = DWRITE_FONT_STYLE_ITALIC;
+
     HRESULT hr = pDWriteFactory->CreateTextFormat(
-        face.c_str(), NULL,
-        bold ? DWRITE_FONT_WEIGHT_BOLD : DWRITE_FONT_WEIGHT_REGULAR,
-        italic ? DWRITE_FONT_STYLE_ITALIC : DWRITE_FONT_STYLE_NORMAL,
-        DWRITE_FONT_STRETCH_NORMAL, (float)face_size, L"zh-CN", &pTextFormat);
+        font.family.c_str(), NULL, font.weight, font.style, font.stretch,
+        (float)face_size, locale.c_str(), &pTextFormat);
+
+    IDWriteTextFormat1 *pTextFormat1 = nullptr;
+    CachedFontFallback *pFallback = CachedFontFallback::Get(pDWriteFactory);
+    if (SUCCEEDED(hr) && pFallback &&
+        SUCCEEDED(pTextFormat->QueryInterface<IDWriteTextFormat1>(
+            &pTextFormat1))) {
+      /* the format keeps the system fallback if ours is refused */
+      if (FAILED(pTextFormat1->SetFontFallback(pFallback)))
+        blog(LOG_WARNING,
+             "[text_directwrite] font fallback cache not installed, "
+             "using the system fallback");
+      SafeRelease(&pTextFormat1);
+    }
 
     if (SUCCEEDED(hr)) {
       pTextFormat->SetTextAlignment(align);
@@ -247,6 +1014,16 @@ void TextSource::UpdateFont() {
             DWRITE_READING_DIRECTION_TOP_TO_BOTTOM);
         pTextFormat->SetFlowDirection(DWRITE_FLOW_DIRECTION_RIGHT_TO_LEFT);
       }
+
+      IDWriteTextLayout *pTextLayout = nullptr;
+      DWRITE_TEXT_METRICS textMetrics;
+      if (SUCCEEDED(pDWriteFactory->CreateTextLayout(
+              L"Ag", 2, pTextFormat, MAX_SIZE_CX, MAX_SIZE_CY, &pTextLayout)) &&
+          SUCCEEDED(pTextLayout->GetMetrics(&textMetrics))) {
+        line_height = vertical ? textMetrics.width : textMetrics.height;
+      }
+      SafeRelease(&pTextLayout);
+      window_dirty = true;
     }
   }
 }
@@ -254,6 +1031,13 @@ void TextSource::UpdateFont() {
 #define obs_data_get_uint32 (uint32_t) obs_data_get_int
 
 inline void TextSource::Update(obs_data_t *s) {
+  TRACE_SCOPE("Update", obs_source_get_name(source));
+  if (Recording()) {
+    const char *json = obs_data_get_json(s);
+    WorkloadRecorder::Record(WORKLOAD_UPDATE, 0, obs_source_get_name(source),
+                             json, strlen(json));
+  }
+
   const char *new_text = obs_data_get_string(s, S_TEXT);
   obs_data_t *font_obj = obs_data_get_obj(s, S_FONT);
   const char *align_str = obs_data_get_string(s, S_ALIGN);
@@ -279,6 +1063,19 @@ inline void TextSource::Update(obs_data_t *s) {
   bool new_extends_wrap = obs_data_get_bool(s, S_EXTENTS_WRAP);
   uint32_t n_extents_cx = obs_data_get_uint32(s, S_EXTENTS_CX);
   uint32_t n_extents_cy = obs_data_get_uint32(s, S_EXTENTS_CY);
+  bool new_marquee = obs_data_get_bool(s, S_MARQUEE);
+  float new_marquee_speed = (float)obs_data_get_double(s, S_MARQUEE_SPEED);
+  uint32_t new_render_rate = obs_data_get_uint32(s, S_RENDER_RATE);
+  bool new_scale_aware = obs_data_get_bool(s, S_SCALE_AWARE);
+  bool new_virtual = obs_data_get_bool(s, S_VIRTUAL);
+  int new_scroll_line = (int)obs_data_get_int(s, S_SCROLL_LINE);
+  float new_auto_scroll = (float)obs_data_get_double(s, S_AUTO_SCROLL);
+  const char *effect_str = obs_data_get_string(s, S_EFFECT);
+  float new_effect_speed = (float)obs_data_get_double(s, S_EFFECT_SPEED);
+  float new_effect_duration =
+      (float)obs_data_get_double(s, S_EFFECT_DURATION);
+
+  const char *locale_str = obs_data_get_string(s, S_LOCALE);
 
   const char *font_face = obs_data_get_string(font_obj, "face");
   int font_size = (int)obs_data_get_int(font_obj, "size");
@@ -293,8 +1090,8 @@ inline void TextSource::Update(obs_data_t *s) {
 
   /* ----------------------------- */
 
-  DWRITE_TEXT_ALIGNMENT new_align = align;
-  DWRITE_PARAGRAPH_ALIGNMENT new_valign = valign;
+  DWRITE_TEXT_ALIGNMENT new_align = DWRITE_TEXT_ALIGNMENT_LEADING;
+  DWRITE_PARAGRAPH_ALIGNMENT new_valign = DWRITE_PARAGRAPH_ALIGNMENT_NEAR;
 
   if (strcmp(align_str, S_ALIGN_CENTER) == 0) {
     if (new_vertical) {
@@ -336,113 +1133,463 @@ inline void TextSource::Update(obs_data_t *s) {
     }
   }
 
-  wstring new_face = to_wide(font_face);
+  shared_ptr<TextSettings> next = make_shared<TextSettings>();
 
-  if (wrap != new_extends_wrap || new_face != face || face_size != font_size ||
-      new_bold != bold || new_italic != italic || new_underline != underline ||
-      new_strikeout != strikeout || vertical != new_vertical ||
-      align != new_align || valign != new_valign) {
-    wrap = new_extends_wrap;
-    face = new_face;
-    face_size = font_size;
-    bold = new_bold;
-    italic = new_italic;
-    underline = new_underline;
-    strikeout = new_strikeout;
+  next->wrap = new_extends_wrap;
+  next->face = to_wide(font_face);
+  next->locale = to_wide(locale_str);
+  next->face_size = font_size;
+  next->bold = new_bold;
+  next->italic = new_italic;
+  next->underline = new_underline;
+  next->strikeout = new_strikeout;
 
-    vertical = new_vertical;
+  next->vertical = new_vertical;
 
-    align = new_align;
-    valign = new_valign;
-
-    UpdateFont();
-  }
+  next->align = new_align;
+  next->valign = new_valign;
 
   /* ----------------------------- */
 
-  new_color = rgb_to_bgr(new_color);
-  new_color2 = rgb_to_bgr(new_color2);
-  new_color3 = rgb_to_bgr(new_color3);
-  new_color4 = rgb_to_bgr(new_color4);
-  new_o_color = rgb_to_bgr(new_o_color);
-  new_bk_color = rgb_to_bgr(new_bk_color);
-
-  color = new_color;
-  opacity = new_opacity;
-  color2 = new_color2;
-  color3 = new_color3;
-  color4 = new_color4;
-  opacity2 = new_opacity2;
-  gradient_dir = new_grad_dir;
+  next->color = rgb_to_bgr(new_color);
+  next->opacity = new_opacity;
+  next->color2 = rgb_to_bgr(new_color2);
+  next->color3 = rgb_to_bgr(new_color3);
+  next->color4 = rgb_to_bgr(new_color4);
+  next->opacity2 = new_opacity2;
+  next->gradient_dir = new_grad_dir;
 
   if (strcmp(gradient_str, S_GRADIENT_NONE) == 0) {
-    gradient_count = 0;
+    next->gradient_count = 0;
   } else if (strcmp(gradient_str, S_GRADIENT_TWO) == 0) {
-    gradient_count = 2;
+    next->gradient_count = 2;
   } else if (strcmp(gradient_str, S_GRADIENT_THREE) == 0) {
-    gradient_count = 3;
+    next->gradient_count = 3;
+  } else {
+    next->gradient_count = 4;
+  }
+
+  next->bk_color = rgb_to_bgr(new_bk_color);
+  next->bk_opacity = new_bk_opacity;
+  next->use_extents = new_extents;
+  next->extents_cx = n_extents_cx;
+  next->extents_cy = n_extents_cy;
+
+  next->read_from_file = new_use_file;
+  next->file = new_file;
+  next->settings_text = new_text;
+
+  next->chatlog_mode = new_chat_mode;
+  next->chatlog_lines = new_chat_lines;
+
+  next->marquee = new_marquee;
+  next->marquee_speed = new_marquee_speed;
+  next->max_render_rate = new_render_rate;
+  next->scale_aware = new_scale_aware;
+
+  next->virtual_layout = new_virtual;
+  next->scroll_line = new_scroll_line;
+  next->auto_scroll_speed = new_auto_scroll;
+
+  if (strcmp(effect_str, S_EFFECT_TYPEWRITER) == 0) {
+    next->effect = EFFECT_TYPEWRITER;
+  } else if (strcmp(effect_str, S_EFFECT_FADE) == 0) {
+    next->effect = EFFECT_FADE;
+  } else if (strcmp(effect_str, S_EFFECT_SLIDE) == 0) {
+    next->effect = EFFECT_SLIDE;
+  } else if (strcmp(effect_str, S_EFFECT_WAVE) == 0) {
+    next->effect = EFFECT_WAVE;
   } else {
-    gradient_count = 4;
+    next->effect = EFFECT_NONE;
+  }
+  next->effect_speed = new_effect_speed;
+  next->effect_duration = new_effect_duration;
+
+  next->use_outline = new_outline;
+  next->outline_color = rgb_to_bgr(new_o_color);
+  next->outline_opacity = new_o_opacity;
+  next->outline_size = roundf(float(new_o_size));
+
+  atomic_store(&pending_settings, shared_ptr<const TextSettings>(next));
+  RequestRender();
+
+  /* ----------------------------- */
+
+  obs_data_release(font_obj);
+}
+
+void TextSource::ApplySettings(const TextSettings &next) {
+  if (wrap != next.wrap || face != next.face || face_size != next.face_size ||
+      locale != next.locale || bold != next.bold || italic != next.italic ||
+      underline != next.underline || strikeout != next.strikeout ||
+      vertical != next.vertical || align != next.align ||
+      valign != next.valign) {
+    font_dirty = true;
   }
 
-  bk_color = new_bk_color;
-  bk_opacity = new_bk_opacity;
-  use_extents = new_extents;
-  extents_cx = n_extents_cx;
-  extents_cy = n_extents_cy;
+  if (marquee != next.marquee) marquee_offset = 0.f;
+  if (!next.scale_aware) raster_scale = 1.f;
+  if (scroll_line != next.scroll_line)
+    scroll_pos = (float)max(next.scroll_line, 0);
 
-  read_from_file = new_use_file;
+  /* pushed text survives edits that leave the text setting alone */
+  if (settings_text != next.settings_text) raw_text = next.settings_text;
 
-  chatlog_mode = new_chat_mode;
-  chatlog_lines = new_chat_lines;
+  static_cast<TextSettings &>(*this) = next;
 
   if (read_from_file) {
-    file = new_file;
-    file_timestamp = get_modified_timestamp(new_file);
-    LoadFileText();
+    file_timestamp = get_modified_timestamp(file.c_str(), &file_size);
+    file_changed = true;
+    file_hash = 0;
   } else {
-    text = to_wide(GetMainString(new_text));
+    text = to_wide(GetMainString(raw_text.c_str()));
   }
 
-  use_outline = new_outline;
-  outline_color = new_o_color;
-  outline_opacity = new_o_opacity;
-  outline_size = roundf(float(new_o_size));
-
-  RenderText();
   update_time_elapsed = 0.0f;
+}
 
-  /* ----------------------------- */
+inline void TextSource::Tick(float seconds) {
+  TRACE_SCOPE("Tick", obs_source_get_name(source));
+  if (Recording())
+    WorkloadRecorder::Record(WORKLOAD_TICK, 0, obs_source_get_name(source),
+                             &seconds, sizeof(seconds));
 
-  obs_data_release(font_obj);
+  if (StepReplay(seconds)) return;
+
+  MemoryBudget::Enforce();
+
+  shared_ptr<const TextSettings> next = atomic_load(&pending_settings);
+  if (next && next != applied_settings) {
+    applied_settings = next;
+    ApplySettings(*next);
+  }
+
+  if (push_pending) ApplyPushedText();
+
+  /* the font index was rebuilt, a name that fell back may resolve now */
+  if (!font_dirty && font_generation != FontCache::Generation()) {
+    font_dirty = true;
+    RequestRender();
+  }
+
+  /* hidden sources only collect dirty state, the first tick after they are
+   * shown or activated catches up before the source is drawn in that frame.
+   * a source that never rendered is warmed up ahead so it reports its size
+   * to scenes that are not shown yet. */
+  if (!showing && !active) {
+    was_showing = false;
+
+    bool unsized = render_pending && !output;
+    if ((!pD2DFactory || font_dirty || unsized) &&
+        RenderScheduler::AcquireWarmup()) {
+      if (unsized) {
+        FlushRender(true);
+      } else {
+        uint64_t start = os_gettime_ns();
+        PrepareResources();
+        RenderScheduler::Release(os_gettime_ns() - start);
+      }
+    }
+    return;
+  }
+
+  bool catch_up = !was_showing;
+  was_showing = true;
+  last_shown = os_gettime_ns();
+
+  if (marquee && output) {
+    float length = float(vertical ? output->tex_cy : output->tex_cx);
+    marquee_offset = fmodf(marquee_offset + marquee_speed * seconds, length);
+    if (marquee_offset < 0.f) marquee_offset += length;
+  }
+
+  if (effect != EFFECT_NONE) {
+    effect_time += seconds;
+    if (effect == EFFECT_WAVE && effect_duration > 0.f)
+      effect_time = fmodf(effect_time, effect_duration);
+  }
+
+  if (auto_scroll_speed != 0.f && IsVirtual() && !line_index.empty()) {
+    float lines = (float)line_index.size();
+    size_t line = (size_t)scroll_pos;
+    scroll_pos = fmodf(scroll_pos + auto_scroll_speed * seconds, lines);
+    if (scroll_pos < 0.f) scroll_pos += lines;
+
+    if ((size_t)scroll_pos != line) {
+      window_dirty = true;
+      RequestRender();
+    }
+  }
+
+  if (scale_aware && !marquee) UpdateRasterScale();
+
+  render_time_elapsed += seconds;
+
+  if (read_from_file) {
+    update_time_elapsed += seconds;
+
+    if (catch_up || update_time_elapsed >= 1.f) {
+      int64_t size = 0;
+      time_t t = get_modified_timestamp(file.c_str(), &size);
+      update_time_elapsed = 0.f;
+
+      /* appends within the same second only show in the size */
+      if (file_timestamp != t || file_size != size) {
+        file_changed = true;
+        file_timestamp = t;
+        file_size = size;
+        RequestRender();
+      }
+    }
+  }
+
+  if (render_pending) FlushRender(catch_up);
 }
 
-inline void TextSource::Tick(float seconds) {
-  if (!read_from_file) return;
+/* pick the smallest bucket that still covers the scale the source was drawn
+ * at, so the texture is never magnified. moving down takes another half
+ * bucket of margin and every move waits for the scale to settle, so an
+ * animated transform does not re-render on every frame. */
+void TextSource::UpdateRasterScale() {
+  float seen = render_scale_seen;
+  render_scale_seen = 0.f;
+  if (seen <= 0.f) return;
+
+  float steps = log2f(seen) * RASTER_SCALE_STEPS;
+  float current = roundf(log2f(raster_scale) * RASTER_SCALE_STEPS);
+  float target = ceilf(steps - 0.01f);
+  clamp(target, log2f(MIN_RASTER_SCALE) * RASTER_SCALE_STEPS,
+        log2f(MAX_RASTER_SCALE) * RASTER_SCALE_STEPS);
+
+  if (target == current || (target < current && steps > current - 1.5f)) {
+    raster_scale_frames = 0;
+    return;
+  }
+  if (++raster_scale_frames < RASTER_SCALE_SETTLE) return;
+
+  raster_scale = exp2f(target / RASTER_SCALE_STEPS);
+  raster_scale_frames = 0;
+  RequestRender();
+}
 
-  update_time_elapsed += seconds;
+/* a source can be drawn several times a frame (program, preview,
+ * projectors); the largest scale of them decides the raster size */
+void TextSource::TrackRenderScale() {
+  struct matrix4 m;
+  gs_matrix_get(&m);
 
-  if (update_time_elapsed >= 1.f) {
-    time_t t = get_modified_timestamp(file.c_str());
-    update_time_elapsed = 0.f;
+  float sx = sqrtf(m.x.x * m.x.x + m.x.y * m.x.y);
+  float sy = sqrtf(m.y.x * m.y.x + m.y.y * m.y.y);
+  render_scale_seen = max(render_scale_seen, max(sx, sy));
+}
 
-    if (file_timestamp != t) {
-      LoadFileText();
-      RenderText();
-      file_timestamp = t;
+void TextSource::RenderMarquee(const RenderOutput &out, gs_eparam_t *image) {
+  /* the tiles hold the whole string once; walk them from the scroll offset
+   * and wrap around until the view is covered, shifting by the sub-pixel
+   * remainder so slow speeds still move smoothly */
+  uint32_t length = vertical ? out.tex_cy : out.tex_cx;
+  uint32_t view = vertical ? out.cy : out.cx;
+  uint32_t pos = (uint32_t)marquee_offset;
+  float frac = marquee_offset - (float)pos;
+  if (pos >= length) pos = 0;
+  if (frac > 0.f) view++;
+
+  gs_matrix_push();
+  if (vertical)
+    gs_matrix_translate3f(0.f, -frac, 0.f);
+  else
+    gs_matrix_translate3f(-frac, 0.f, 0.f);
+
+  uint32_t drawn = 0;
+  while (drawn < view) {
+    size_t tile = out.tiles.empty() ? 0 : pos / MARQUEE_TILE_SIZE;
+    uint32_t first = (uint32_t)tile * MARQUEE_TILE_SIZE;
+    uint32_t end = out.tiles.empty() ? length
+                                     : min(length, first + MARQUEE_TILE_SIZE);
+    uint32_t part = min(end - pos, view - drawn);
+    gs_texture_t *tex = out.Tile(tile);
+    gs_effect_set_texture(image, tex);
+
+    gs_matrix_push();
+    if (vertical) {
+      gs_matrix_translate3f(0.f, (float)drawn, 0.f);
+      gs_draw_sprite_subregion(tex, 0, 0, pos - first, out.tex_cx, part);
+    } else {
+      gs_matrix_translate3f((float)drawn, 0.f, 0.f);
+      gs_draw_sprite_subregion(tex, 0, pos - first, 0, part, out.tex_cy);
     }
+    gs_matrix_pop();
+
+    drawn += part;
+    pos += part;
+    if (pos >= length) pos = 0;
   }
+
+  gs_matrix_pop();
+}
+
+/* how much of the new text was already shown: the old text from one of its
+ * line starts on (lines scrolled out at the top, new ones appended), or
+ * else the prefix both share */
+static size_t shown_length(const wstring &before, const wstring &after) {
+  for (size_t line = 0; line < before.size();) {
+    size_t len = before.size() - line;
+    if (len <= after.size() && after.compare(0, len, before, line, len) == 0)
+      return len;
+
+    line = before.find(L'\n', line);
+    if (line == wstring::npos) break;
+    line++;
+  }
+
+  size_t len = 0;
+  while (len < before.size() && len < after.size() &&
+         before[len] == after[len])
+    len++;
+  return len;
+}
+
+void TextSource::StartEffect() {
+  if (effect == EFFECT_NONE) {
+    effect_text.clear();
+    return;
+  }
+  if (text == effect_text) return;
+
+  effect_from = shown_length(effect_text, text);
+  effect_text = text;
+  effect_time = 0.f;
+}
+
+static gs_effect_t *animate_effect = nullptr;
+static bool animate_effect_loaded = false;
+
+/* loaded on first use, from the video thread inside the graphics context */
+static gs_effect_t *get_animate_effect() {
+  if (!animate_effect_loaded) {
+    animate_effect_loaded = true;
+
+    char *path = obs_module_file("effects/text_animate.effect");
+    animate_effect = gs_effect_create_from_file(path, nullptr);
+    bfree(path);
+
+    if (!animate_effect)
+      blog(LOG_WARNING,
+           "[text_directwrite] cannot load the animation effect, text is "
+           "drawn without animations");
+  }
+  return animate_effect;
+}
+
+static void release_animate_effect() {
+  if (!animate_effect) return;
+
+  obs_enter_graphics();
+  gs_effect_destroy(animate_effect);
+  obs_leave_graphics();
+  animate_effect = nullptr;
+}
+
+static const TextLine &find_line(const vector<TextLine> &lines, size_t pos) {
+  auto line = upper_bound(
+      lines.begin(), lines.end(), pos,
+      [](size_t pos, const TextLine &line) { return pos < line.first; });
+  return line == lines.begin() ? *line : *(line - 1);
+}
+
+/* the texture is drawn once through a mask shader; the frame only sets a few
+ * positions taken from the recorded line boxes, so the cost does not depend
+ * on the text. returns false when there is nothing left to animate. */
+bool TextSource::RenderEffect(const RenderOutput &out) {
+  if (out.lines.empty()) return false;
+
+  size_t length = out.char_right.size();
+  vec4 reveal, fade, wave;
+  vec4_zero(&reveal);
+  vec4_zero(&fade);
+  vec4_zero(&wave);
+
+  switch (effect) {
+    case EFFECT_TYPEWRITER: {
+      size_t shown = effect_from + (size_t)(effect_time * effect_speed);
+      if (shown >= length) return false;
+
+      const TextLine &line = find_line(out.lines, shown);
+      float x = shown > line.first ? out.char_right[shown - 1] : 0.f;
+      vec4_set(&reveal, x, line.top, line.bottom, 1.f);
+      break;
+    }
+    case EFFECT_FADE:
+    case EFFECT_SLIDE: {
+      if (effect_from >= length || effect_time >= effect_duration)
+        return false;
+
+      float progress = effect_time / effect_duration;
+      progress = progress * progress * (3.f - 2.f * progress);
+
+      const TextLine &line = find_line(out.lines, effect_from);
+      float offset = 0.f;
+      if (effect == EFFECT_SLIDE)
+        offset = (1.f - progress) * (line.bottom - line.top);
+      vec4_set(&fade, line.top, progress, offset, 1.f);
+      break;
+    }
+    case EFFECT_WAVE: {
+      float size = face_size * out.scale;
+      float period = effect_duration > 0.f ? effect_duration : 1.f;
+      float tau = 6.28318531f;
+      vec4_set(&wave, size * WAVE_AMPLITUDE, tau / (size * WAVE_LENGTH),
+               tau * effect_time / period, 0.f);
+      break;
+    }
+    default:
+      return false;
+  }
+
+  gs_effect_t *fx = get_animate_effect();
+  if (!fx) return false;
+
+  uint32_t bk = premultiply_color(bk_color, bk_opacity);
+  vec4 background;
+  vec4_set(&background, ((bk >> 16) & 0xFF) / 255.f,
+           ((bk >> 8) & 0xFF) / 255.f, (bk & 0xFF) / 255.f,
+           (bk >> 24) / 255.f);
+
+  vec2 size;
+  vec2_set(&size, (float)out.tex_cx, (float)out.tex_cy);
+
+  gs_texture_t *tex = out.tex.get();
+  gs_effect_set_texture(gs_effect_get_param_by_name(fx, "image"), tex);
+  gs_effect_set_vec2(gs_effect_get_param_by_name(fx, "size"), &size);
+  gs_effect_set_vec4(gs_effect_get_param_by_name(fx, "background"),
+                     &background);
+  gs_effect_set_vec4(gs_effect_get_param_by_name(fx, "reveal"), &reveal);
+  gs_effect_set_vec4(gs_effect_get_param_by_name(fx, "fade"), &fade);
+  gs_effect_set_vec4(gs_effect_get_param_by_name(fx, "wave"), &wave);
+
+  while (gs_effect_loop(fx, "Draw")) gs_draw_sprite(tex, 0, out.cx, out.cy);
+  return true;
 }
 
 inline void TextSource::Render() {
-  if (!tex) return;
-  gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
-  gs_technique_t *tech = gs_effect_get_technique(effect, "Draw");
+  if (!output || !output->tex) return;
+  TRACE_SCOPE("Render", obs_source_get_name(source));
+  if (scale_aware) TrackRenderScale();
+
+  if (effect != EFFECT_NONE && !marquee && RenderEffect(*output)) return;
+
+  gs_texture_t *tex = output->tex.get();
+  gs_effect_t *base_effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+  gs_technique_t *tech = gs_effect_get_technique(base_effect, "Draw");
   gs_technique_begin(tech);
   gs_technique_begin_pass(tech, 0);
 
-  gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
-  gs_draw_sprite(tex, 0, cx, cy);
+  gs_eparam_t *image = gs_effect_get_param_by_name(base_effect, "image");
+  gs_effect_set_texture(image, tex);
+  if (marquee)
+    RenderMarquee(*output, image);
+  else
+    gs_draw_sprite(tex, 0, output->cx, output->cy);
 
   gs_technique_end_pass(tech);
   gs_technique_end(tech);
@@ -459,12 +1606,21 @@ OBS_MODULE_USE_DEFAULT_LOCALE("obs-text", "en-US")
     obs_property_set_visible(p, var == show); \
   } while (false)
 
+static void proc_dump_trace(void *, calldata_t *cd) {
+  const char *path = calldata_string(cd, "path");
+  if (!path || !*path) path = getenv(TRACE_ENV);
+  calldata_set_bool(cd, "success", TraceLog::Dump(path));
+}
+
 static bool use_file_changed(obs_properties_t *props, obs_property_t *p,
                              obs_data_t *s) {
   bool use_file = obs_data_get_bool(s, S_USE_FILE);
 
   set_vis(use_file, S_TEXT, false);
   set_vis(use_file, S_FILE, true);
+  set_vis(use_file, S_VIRTUAL, true);
+  set_vis(use_file && obs_data_get_bool(s, S_VIRTUAL), S_SCROLL_LINE, true);
+  set_vis(use_file && obs_data_get_bool(s, S_VIRTUAL), S_AUTO_SCROLL, true);
   return true;
 }
 
@@ -523,8 +1679,39 @@ static bool extents_modified(obs_properties_t *props, obs_property_t *p,
   return true;
 }
 
+static bool marquee_changed(obs_properties_t *props, obs_property_t *p,
+                            obs_data_t *s) {
+  bool marquee = obs_data_get_bool(s, S_MARQUEE);
+
+  set_vis(marquee, S_MARQUEE_SPEED, true);
+  return true;
+}
+
+static bool effect_changed(obs_properties_t *props, obs_property_t *p,
+                           obs_data_t *s) {
+  const char *effect = obs_data_get_string(s, S_EFFECT);
+  bool typewriter = strcmp(effect, S_EFFECT_TYPEWRITER) == 0;
+  bool none = strcmp(effect, S_EFFECT_NONE) == 0;
+
+  set_vis(typewriter, S_EFFECT_SPEED, true);
+  set_vis(typewriter || none, S_EFFECT_DURATION, false);
+  return true;
+}
+
 #undef set_vis
 
+static void handle_push(push_op op, const string &name, const string &payload) {
+  obs_source_t *source = obs_get_source_by_name(name.c_str());
+  if (!source) return;
+
+  if (strcmp(obs_source_get_id(source), TEXT_SOURCE_ID) == 0) {
+    TextSource *s = reinterpret_cast<TextSource *>(obs_obj_get_data(source));
+    if (s) s->PushText(op, payload.data(), payload.size());
+  }
+
+  obs_source_release(source);
+}
+
 static obs_properties_t *get_properties(void *data) {
   TextSource *s = reinterpret_cast<TextSource *>(data);
   string path;
@@ -543,10 +1730,13 @@ static obs_properties_t *get_properties(void *data) {
   filter += T_FILTER_ALL_FILES;
   filter += " (*.*)";
 
-  if (s && !s->file.empty()) {
+  shared_ptr<const TextSettings> settings =
+      s ? atomic_load(&s->pending_settings) : nullptr;
+
+  if (settings && !settings->file.empty()) {
     const char *slash;
 
-    path = s->file;
+    path = settings->file;
     replace(path.begin(), path.end(), '\\', '/');
     slash = strrchr(path.c_str(), '/');
     if (slash) path.resize(slash - path.c_str() + 1);
@@ -556,6 +1746,21 @@ static obs_properties_t *get_properties(void *data) {
   obs_properties_add_path(props, S_FILE, T_FILE, OBS_PATH_FILE, filter.c_str(),
                           path.c_str());
 
+  p = obs_properties_add_bool(props, S_VIRTUAL, T_VIRTUAL);
+  obs_property_set_modified_callback(p, use_file_changed);
+  obs_properties_add_int(props, S_SCROLL_LINE, T_SCROLL_LINE, 0, INT_MAX, 1);
+  p = obs_properties_add_float_slider(props, S_AUTO_SCROLL, T_AUTO_SCROLL,
+                                      -100.0, 100.0, 0.1);
+  obs_property_float_set_suffix(p, " lines/s");
+
+  p = obs_properties_add_list(props, S_LOCALE, T_LOCALE,
+                              OBS_COMBO_TYPE_EDITABLE, OBS_COMBO_FORMAT_STRING);
+  obs_property_list_add_string(p, "en-US", "en-US");
+  obs_property_list_add_string(p, "zh-CN", "zh-CN");
+  obs_property_list_add_string(p, "zh-TW", "zh-TW");
+  obs_property_list_add_string(p, "ja-JP", "ja-JP");
+  obs_property_list_add_string(p, "ko-KR", "ko-KR");
+
   obs_properties_add_bool(props, S_VERTICAL, T_VERTICAL);
   obs_properties_add_color(props, S_COLOR, T_COLOR);
   p = obs_properties_add_int_slider(props, S_OPACITY, T_OPACITY, 0, 100, 1);
@@ -620,12 +1825,44 @@ static obs_properties_t *get_properties(void *data) {
   obs_properties_add_int(props, S_EXTENTS_CY, T_EXTENTS_CY, 32, 8000, 1);
   obs_properties_add_bool(props, S_EXTENTS_WRAP, T_EXTENTS_WRAP);
 
+  p = obs_properties_add_bool(props, S_MARQUEE, T_MARQUEE);
+  obs_property_set_modified_callback(p, marquee_changed);
+
+  p = obs_properties_add_float_slider(props, S_MARQUEE_SPEED, T_MARQUEE_SPEED,
+                                      -1000.0, 1000.0, 0.1);
+  obs_property_float_set_suffix(p, " px/s");
+
+  p = obs_properties_add_list(props, S_EFFECT, T_EFFECT, OBS_COMBO_TYPE_LIST,
+                              OBS_COMBO_FORMAT_STRING);
+  obs_property_list_add_string(p, T_EFFECT_NONE, S_EFFECT_NONE);
+  obs_property_list_add_string(p, T_EFFECT_TYPEWRITER, S_EFFECT_TYPEWRITER);
+  obs_property_list_add_string(p, T_EFFECT_FADE, S_EFFECT_FADE);
+  obs_property_list_add_string(p, T_EFFECT_SLIDE, S_EFFECT_SLIDE);
+  obs_property_list_add_string(p, T_EFFECT_WAVE, S_EFFECT_WAVE);
+  obs_property_set_modified_callback(p, effect_changed);
+
+  p = obs_properties_add_float_slider(props, S_EFFECT_SPEED, T_EFFECT_SPEED,
+                                      1.0, 200.0, 1.0);
+  obs_property_float_set_suffix(p, " /s");
+
+  p = obs_properties_add_float_slider(props, S_EFFECT_DURATION,
+                                      T_EFFECT_DURATION, 0.1, 10.0, 0.1);
+  obs_property_float_set_suffix(p, " s");
+
+  p = obs_properties_add_int(props, S_RENDER_RATE, T_RENDER_RATE, 0, 240, 1);
+  obs_property_int_set_suffix(p, " /s");
+
+  obs_properties_add_bool(props, S_SCALE_AWARE, T_SCALE_AWARE);
+
+  obs_properties_add_text(props, S_MEMORY_INFO,
+                          MemoryBudget::Report().c_str(), OBS_TEXT_INFO);
+
   return props;
 }
 
 bool obs_module_load(void) {
   obs_source_info si = {};
-  si.id = "text_directwrite";
+  si.id = TEXT_SOURCE_ID;
   si.icon_type = OBS_ICON_TYPE_TEXT;
   si.type = OBS_SOURCE_TYPE_INPUT;
   si.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW;
@@ -637,10 +1874,10 @@ bool obs_module_load(void) {
   };
   si.destroy = [](void *data) { delete reinterpret_cast<TextSource *>(data); };
   si.get_width = [](void *data) {
-    return reinterpret_cast<TextSource *>(data)->cx;
+    return reinterpret_cast<TextSource *>(data)->GetWidth();
   };
   si.get_height = [](void *data) {
-    return reinterpret_cast<TextSource *>(data)->cy;
+    return reinterpret_cast<TextSource *>(data)->GetHeight();
   };
   si.get_defaults = [](obs_data_t *settings) {
     obs_data_t *font_obj = obs_data_create();
@@ -648,6 +1885,7 @@ bool obs_module_load(void) {
     obs_data_set_default_int(font_obj, "size", 36);
 
     obs_data_set_default_obj(settings, S_FONT, font_obj);
+    obs_data_set_default_string(settings, S_LOCALE, "zh-CN");
     obs_data_set_default_string(settings, S_ALIGN, S_ALIGN_LEFT);
     obs_data_set_default_string(settings, S_VALIGN, S_VALIGN_TOP);
     obs_data_set_default_int(settings, S_COLOR, 0xFFFFFF);
@@ -666,6 +1904,11 @@ bool obs_module_load(void) {
     obs_data_set_default_bool(settings, S_EXTENTS_WRAP, true);
     obs_data_set_default_int(settings, S_EXTENTS_CX, 100);
     obs_data_set_default_int(settings, S_EXTENTS_CY, 100);
+    obs_data_set_default_double(settings, S_MARQUEE_SPEED, 100.0);
+    obs_data_set_default_bool(settings, S_SCALE_AWARE, true);
+    obs_data_set_default_string(settings, S_EFFECT, S_EFFECT_NONE);
+    obs_data_set_default_double(settings, S_EFFECT_SPEED, 30.0);
+    obs_data_set_default_double(settings, S_EFFECT_DURATION, 0.5);
 
     obs_data_release(font_obj);
   };
@@ -678,10 +1921,42 @@ bool obs_module_load(void) {
   si.video_render = [](void *data, gs_effect_t *effect) {
     reinterpret_cast<TextSource *>(data)->Render();
   };
+  si.show = [](void *data) {
+    reinterpret_cast<TextSource *>(data)->showing = true;
+  };
+  si.hide = [](void *data) {
+    reinterpret_cast<TextSource *>(data)->showing = false;
+  };
+  si.activate = [](void *data) {
+    reinterpret_cast<TextSource *>(data)->active = true;
+  };
+  si.deactivate = [](void *data) {
+    reinterpret_cast<TextSource *>(data)->active = false;
+  };
 
   obs_register_source(&si);
 
+  FontCache::Warmup();
+  MemoryBudget::Load();
+  TraceLog::Start();
+  proc_handler_add(obs_get_proc_handler(),
+                   "void text_directwrite_dump_trace(in string path, "
+                   "out bool success)",
+                   proc_dump_trace, nullptr);
+  StagingTarget::Startup();
+  WorkloadRecorder::Start();
+  PushServer::Start(handle_push);
+
   return true;
 }
 
-void obs_module_unload(void) {}
+void obs_module_unload(void) {
+  TraceLog::Stop();
+  MemoryBudget::LogUsage();
+  PushServer::Stop();
+  WorkloadRecorder::Stop();
+  CachedFontFallback::Shutdown();
+  StagingTarget::Shutdown();
+  FontCache::Shutdown();
+  release_animate_effect();
+}
@@ -1,6 +1,9 @@
 #pragma once
 #pragma once
 
+#include <graphics/matrix4.h>
+#include <graphics/vec2.h>
+#include <graphics/vec4.h>
 #include <math.h>
 #include <obs-module.h>
 #include <sys/stat.h>
@@ -8,11 +11,31 @@
 #include <windows.h>
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <string>
 #include <util/util.hpp>
+#include <vector>
 
+#include "CachedFontFallback.h"
+#include "Compositing.h"
+#include "ContentHash.h"
 #include "CustomTextRenderer.h"
+#include "FontCache.h"
+#include "GlyphRunCache.h"
+#include "MappedFile.h"
+#include "MemoryBudget.h"
+#include "PushServer.h"
+#include "RenderArena.h"
+#include "RenderScheduler.h"
+#include "StagingTarget.h"
+#include "TextureCache.h"
+#include "TextUtil.h"
+#include "TraceLog.h"
+#include "WorkloadRecorder.h"
+#include "WorkloadReplay.h"
 
 using namespace std;
 
@@ -24,10 +47,28 @@ using namespace std;
     val = max_val;
 #endif
 
+#define TEXT_SOURCE_ID "text_directwrite"
+
 #define MIN_SIZE_CX 2.0
 #define MIN_SIZE_CY 2.0
 #define MAX_SIZE_CX 4096.0
 #define MAX_SIZE_CY 4096.0
+/* a marquee is laid out up to MAX_MARQUEE_SIZE pixels long and split into
+ * textures of at most MARQUEE_TILE_SIZE along its scroll axis */
+#define MAX_MARQUEE_SIZE 262144.0
+#define MARQUEE_TILE_SIZE 16384
+#define REPLAY_SLICE_NS 50000000ULL
+
+/* raster scale buckets: half-octave steps, switched only after the scene
+ * scale has settled for a while */
+#define MIN_RASTER_SCALE 0.25f
+#define MAX_RASTER_SCALE 4.0f
+#define RASTER_SCALE_STEPS 2.0f
+#define RASTER_SCALE_SETTLE 30
+
+/* wave height and length relative to the font size */
+#define WAVE_AMPLITUDE 0.1f
+#define WAVE_LENGTH 3.0f
 
 /* ------------------------------------------------------------------------- */
 
@@ -62,6 +103,24 @@ constexpr auto S_EXTENTS = "extents";
 constexpr auto S_EXTENTS_WRAP = "extents_wrap";
 constexpr auto S_EXTENTS_CX = "extents_cx";
 constexpr auto S_EXTENTS_CY = "extents_cy";
+constexpr auto S_MARQUEE = "marquee";
+constexpr auto S_MARQUEE_SPEED = "marquee_speed";
+constexpr auto S_RENDER_RATE = "max_render_rate";
+constexpr auto S_SCALE_AWARE = "scale_aware";
+constexpr auto S_MEMORY_INFO = "memory_info";
+constexpr auto S_LOCALE = "locale";
+constexpr auto S_VIRTUAL = "virtual_layout";
+constexpr auto S_SCROLL_LINE = "scroll_line";
+constexpr auto S_AUTO_SCROLL = "auto_scroll_speed";
+constexpr auto S_EFFECT = "effect";
+constexpr auto S_EFFECT_SPEED = "effect_speed";
+constexpr auto S_EFFECT_DURATION = "effect_duration";
+
+constexpr auto S_EFFECT_NONE = "none";
+constexpr auto S_EFFECT_TYPEWRITER = "typewriter";
+constexpr auto S_EFFECT_FADE = "fade";
+constexpr auto S_EFFECT_SLIDE = "slide";
+constexpr auto S_EFFECT_WAVE = "wave";
 
 constexpr auto S_ALIGN_LEFT = "left";
 constexpr auto S_ALIGN_CENTER = "center";
@@ -103,6 +162,22 @@ constexpr auto S_VALIGN_BOTTOM = "bottom";
 #define T_EXTENTS_WRAP T_("UseCustomExtents.Wrap")
 #define T_EXTENTS_CX T_("Width")
 #define T_EXTENTS_CY T_("Height")
+#define T_MARQUEE T_("Marquee")
+#define T_MARQUEE_SPEED T_("Marquee.Speed")
+#define T_RENDER_RATE T_("MaxRenderRate")
+#define T_SCALE_AWARE T_("ScaleAware")
+#define T_LOCALE T_("Locale")
+#define T_VIRTUAL T_("VirtualLayout")
+#define T_SCROLL_LINE T_("VirtualLayout.ScrollLine")
+#define T_AUTO_SCROLL T_("VirtualLayout.AutoScroll")
+#define T_EFFECT T_("Effect")
+#define T_EFFECT_NONE T_("Effect.None")
+#define T_EFFECT_TYPEWRITER T_("Effect.Typewriter")
+#define T_EFFECT_FADE T_("Effect.Fade")
+#define T_EFFECT_SLIDE T_("Effect.Slide")
+#define T_EFFECT_WAVE T_("Effect.Wave")
+#define T_EFFECT_SPEED T_("Effect.Speed")
+#define T_EFFECT_DURATION T_("Effect.Duration")
 
 #define T_FILTER_TEXT_FILES T_("Filter.TextFiles")
 #define T_FILTER_ALL_FILES T_("Filter.AllFiles")
@@ -117,6 +192,17 @@ constexpr auto S_VALIGN_BOTTOM = "bottom";
 
 /* ------------------------------------------------------------------------- */
 
+static inline wstring to_wide(const char *utf8, size_t len) {
+  wstring text;
+  if (!len) return text;
+
+  size_t wlen = os_utf8_to_wcs(utf8, len, nullptr, 0);
+  text.resize(wlen);
+  if (wlen) os_utf8_to_wcs(utf8, len, &text[0], wlen + 1);
+
+  return text;
+}
+
 static inline wstring to_wide(const char *utf8) {
   wstring text;
 
@@ -131,26 +217,24 @@ static inline uint32_t rgb_to_bgr(uint32_t rgb) {
   return ((rgb & 0xFF) << 16) | (rgb & 0xFF00) | ((rgb & 0xFF0000) >> 16);
 }
 
-struct TextSource {
-  obs_source_t *source = nullptr;
-  gs_texture_t *tex = nullptr;
-
-  uint32_t cx = 0;
-  uint32_t cy = 0;
-
-  IDWriteFactory4 *pDWriteFactory = nullptr;
-  IDWriteTextFormat *pTextFormat = nullptr;
-  ID2D1Factory *pD2DFactory = nullptr;
-
-  D2D1_RENDER_TARGET_PROPERTIES props = {};
+enum text_effect {
+  EFFECT_NONE,
+  EFFECT_TYPEWRITER,
+  EFFECT_FADE,
+  EFFECT_SLIDE,
+  EFFECT_WAVE,
+};
 
+/* Everything parsed from the source settings. Update builds a new immutable
+ * copy on the UI thread and publishes it; the video thread adopts the latest
+ * copy on its next tick, so it never sees settings change under it. */
+struct TextSettings {
   bool read_from_file = false;
   string file;
-  time_t file_timestamp = 0;
-  float update_time_elapsed = 0.f;
+  string settings_text;
 
-  wstring text;
   wstring face;
+  wstring locale;
   int face_size = 0;
   uint32_t color = 0xFFFFFF;
   uint32_t color2 = 0xFFFFFF;
@@ -158,13 +242,7 @@ struct TextSource {
   uint32_t color4 = 0xFFFFFF;
 
   int gradient_count = 0;
-  D2D1_GRADIENT_STOP gradientStops[4];
-
   float gradient_dir = 0;
-  float gradient_x = 0;
-  float gradient_y = 0;
-  float gradient2_x = 0;
-  float gradient2_y = 0;
 
   uint32_t opacity = 100;
   uint32_t opacity2 = 100;
@@ -193,41 +271,255 @@ struct TextSource {
   bool chatlog_mode = false;
   int chatlog_lines = 6;
 
+  bool virtual_layout = false;
+  int scroll_line = 0;
+  float auto_scroll_speed = 0.f;
+
+  bool marquee = false;
+  float marquee_speed = 0.f;
+
+  uint32_t max_render_rate = 0;
+  bool scale_aware = true;
+
+  text_effect effect = EFFECT_NONE;
+  float effect_speed = 30.f;
+  float effect_duration = 0.5f;
+};
+
+/* A laid out line in texture pixels, with the range of text it holds. */
+struct TextLine {
+  float top = 0.f;
+  float bottom = 0.f;
+  uint32_t first = 0;
+  uint32_t end = 0;
+};
+
+/* What a render produced. Published as a whole so get_width/get_height on
+ * the UI thread always pair with the texture drawn on the video thread. */
+struct RenderOutput {
+  shared_ptr<gs_texture_t> tex;
+
+  uint32_t cx = 0;
+  uint32_t cy = 0;
+  uint32_t tex_cx = 0;
+  uint32_t tex_cy = 0;
+  float scale = 1.f;
+  bool dynamic = false;
+
+  /* tiles after tex of a marquee longer than one texture; tex_cx and tex_cy
+   * are the size of all tiles together */
+  vector<shared_ptr<gs_texture_t>> tiles;
+
+  inline size_t TileCount() const { return tiles.size() + 1; }
+  inline gs_texture_t *Tile(size_t i) const {
+    return i ? tiles[i - 1].get() : tex.get();
+  }
+  inline bool TiledDown() const { return tex_cy > MARQUEE_TILE_SIZE; }
+
+  /* where each line and character ended up, recorded for animations so
+   * they never need the layout again */
+  vector<TextLine> lines;
+  vector<float> char_right;
+};
+
+static inline shared_ptr<gs_texture_t> make_texture(gs_texture_t *tex) {
+  if (!tex) return nullptr;
+
+  return shared_ptr<gs_texture_t>(tex, [](gs_texture_t *tex) {
+    obs_enter_graphics();
+    gs_texture_destroy(tex);
+    obs_leave_graphics();
+  });
+}
+
+/* The TextSettings base holds the settings currently applied on the video
+ * thread; only ApplySettings writes it. */
+struct TextSource : TextSettings, MemoryConsumer {
+  obs_source_t *source = nullptr;
+
+  shared_ptr<const TextSettings> pending_settings;
+  shared_ptr<const TextSettings> applied_settings;
+  shared_ptr<const RenderOutput> output;
+
+  IDWriteFactory4 *pDWriteFactory = nullptr;
+  IDWriteTextFormat *pTextFormat = nullptr;
+  ID2D1Factory *pD2DFactory = nullptr;
+
+  D2D1_RENDER_TARGET_PROPERTIES props = {};
+
+  StagingTarget staging;
+  RenderArena arena;
+  GlyphRunCache run_cache;
+  bool gdi_upload = false;
+
+  time_t file_timestamp = 0;
+  int64_t file_size = 0;
+  float update_time_elapsed = 0.f;
+
+  wstring text;
+  string raw_text;
+
+  D2D1_GRADIENT_STOP gradientStops[4];
+
+  float gradient_x = 0;
+  float gradient_y = 0;
+  float gradient2_x = 0;
+  float gradient2_y = 0;
+
+  /* large files: only the lines inside the visible window are laid out */
+  vector<size_t> line_index;
+  size_t file_length = 0;
+  bool file_utf16 = false;
+  bool window_dirty = false;
+  float line_height = 0.f;
+  float scroll_pos = 0.f;
+
+  /* text pushed over the pipe, merged until the next tick picks it up */
+  mutex push_mutex;
+  string push_text;
+  bool push_reset = false;
+  atomic_bool push_pending{false};
+
+  /* a recorded workload played back in place of the live inputs */
+  mutex replay_mutex;
+  unique_ptr<WorkloadReplay> replay_pending;
+  unique_ptr<WorkloadReplay> replay;
+  atomic_bool replaying{false};
+
+  float marquee_offset = 0.f;
+  bool marquee_clipped = false;
+
+  /* animations run over the text that was new in the last render */
+  wstring effect_text;
+  size_t effect_from = 0;
+  float effect_time = 0.f;
+
+  /* the texture follows the largest scale the source was drawn at */
+  float raster_scale = 1.f;
+  float render_scale_seen = 0.f;
+  int raster_scale_frames = 0;
+
+  /* renders requested by Update and file changes are coalesced, the latest
+   * state wins and is drawn from Tick once the rate limit allows it */
+  atomic_bool render_pending{false};
+  atomic_bool showing{false};
+  atomic_bool active{false};
+  bool was_showing = false;
+  uint64_t last_shown = 0;
+  bool file_changed = false;
+
+  /* content last loaded from the file, and the render inputs of the
+   * current output before and after trimming to the visible lines */
+  uint64_t file_hash = 0;
+  uint64_t rendered_hash = 0;
+  uint64_t trimmed_hash = 0;
+  bool font_dirty = false;
+  uint32_t font_generation = 0;
+  float render_time_elapsed = 0.f;
+  uint32_t render_frames_waited = 0;
+
+  atomic<uint64_t> stat_coalesced{0};
+  uint64_t stat_renders = 0;
+  uint64_t stat_rate_limited = 0;
+  uint64_t stat_over_budget = 0;
+  uint64_t stat_shared = 0;
+  uint64_t stat_uploads = 0;
+  uint64_t stat_graphics_ns = 0;
+  uint64_t stat_file_unchanged = 0;
+  uint64_t stat_unchanged = 0;
+
   /* --------------------------- */
 
+  /* creation only captures settings, DirectWrite objects and the text
+   * format are built when the source is first shown or warmed while hidden */
   inline TextSource(obs_source_t *source_, obs_data_t *settings)
       : source(source_) {
-    InitializeDirectWrite();
+    RegisterProcs();
     obs_source_update(source, settings);
+    MemoryBudget::Add(this);
   }
 
   inline ~TextSource() {
-    if (tex) {
-      obs_enter_graphics();
-      gs_texture_destroy(tex);
-      obs_leave_graphics();
-    }
+    MemoryBudget::Remove(this);
+    LogRenderStats();
     ReleaseResource();
   }
 
   void UpdateFont();
   void CalculateGradientAxis(float width, float height);
   void InitializeDirectWrite();
+  bool PrepareResources();
   void ReleaseResource();
   void UpdateBrush(ID2D1RenderTarget *pRT, ID2D1Brush **ppOutlineBrush,
                    ID2D1Brush **ppFillBrush, float width, float height);
   void RenderText();
+  HRESULT DrawLayout(ID2D1RenderTarget *pRT, IDWriteTextLayout *pTextLayout,
+                     float scale, float text_cx, float line_cy,
+                     const D2D1_COLOR_F &background,
+                     const D2D1_POINT_2F &origin);
+  shared_ptr<gs_texture_t> RasterizeTile(IDWriteTextLayout *pTextLayout,
+                                         float scale, float text_cx,
+                                         float line_cy, LONG cx, LONG cy,
+                                         const D2D1_POINT_2F &origin,
+                                         const shared_ptr<gs_texture_t> &reuse,
+                                         bool reuse_dynamic, bool &staged);
+  void MeasureLines(IDWriteTextLayout *pTextLayout, float scale,
+                    RenderOutput &out);
+  void StartEffect();
+  bool RenderEffect(const RenderOutput &out);
+  pmr::string RenderKey();
   void LoadFileText();
+  void LoadText(const char *data, size_t len, bool utf16);
+  void IndexFileLines(const MappedFile &mapped);
+  void ExtractWindow();
+  inline bool IsVirtual() const {
+    return read_from_file && virtual_layout && !chatlog_mode;
+  }
+  void RequestRender();
+  void RegisterProcs();
+  void PushText(push_op op, const char *str, size_t len);
+  void ApplyPushedText();
+  void StartReplay(const char *path, const char *name, bool realtime);
+  bool SaveImage(const char *path);
+  /* replayed inputs are not recorded again */
+  inline bool Recording() const {
+    return WorkloadRecorder::Enabled() && !replaying;
+  }
+  bool StepReplay(float seconds);
+  void FlushRender(bool catch_up);
+  void LogRenderStats();
+
+  MemoryUsage GetMemoryUsage() const override;
+  inline bool IsActive() const override { return showing || active; }
+  inline uint64_t LastActive() const override { return last_shown; }
+  size_t ReleaseMemory(bool active) override;
 
   const char *GetMainString(const char *str);
+  void TrimVisualLines();
+
+  void ApplySettings(const TextSettings &next);
+
+  inline uint32_t GetWidth() const {
+    shared_ptr<const RenderOutput> out = atomic_load(&output);
+    return out ? out->cx : 0;
+  }
+  inline uint32_t GetHeight() const {
+    shared_ptr<const RenderOutput> out = atomic_load(&output);
+    return out ? out->cy : 0;
+  }
 
   inline void Update(obs_data_t *settings);
   inline void Tick(float seconds);
   inline void Render();
+  void RenderMarquee(const RenderOutput &out, gs_eparam_t *image);
+  void UpdateRasterScale();
+  void TrackRenderScale();
 };
 
-static time_t get_modified_timestamp(const char *filename) {
+static time_t get_modified_timestamp(const char *filename,
+                                     int64_t *size = nullptr) {
   struct stat stats;
   if (os_stat(filename, &stats) != 0) return -1;
+  if (size) *size = (int64_t)stats.st_size;
   return stats.st_mtime;
 }
@@ -0,0 +1,168 @@
+/* Command line client for the text source push channel.
+ *
+ *   obs_text_push <source> replace <text>
+ *   obs_text_push <source> append <text>
+ *   obs_text_push <source> append_line <text>
+ *   obs_text_push <source> clear
+ *   obs_text_push <source> bench <count> [bytes]
+ *   obs_text_push check
+ *
+ * bench sends <count> append frames of [bytes] characters (default 64), each
+ * ending in a newline, and reports the throughput. check runs frame
+ * sequences through push_merge, the function the source folds frames with,
+ * and verifies the text they leave without connecting. Build with
+ * cl /EHsc /I ..\obs_text_directwrite obs_text_push.cpp */
+
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+#include "PushProtocol.h"
+
+static HANDLE open_pipe() {
+  for (;;) {
+    HANDLE pipe = CreateFileW(PUSH_PIPE_NAME, GENERIC_WRITE, 0, NULL,
+                              OPEN_EXISTING, 0, NULL);
+    if (pipe != INVALID_HANDLE_VALUE) return pipe;
+    if (GetLastError() != ERROR_PIPE_BUSY) return INVALID_HANDLE_VALUE;
+    if (!WaitNamedPipeW(PUSH_PIPE_NAME, 5000)) return INVALID_HANDLE_VALUE;
+  }
+}
+
+static bool write_all(HANDLE pipe, const void *data, size_t len) {
+  const char *pos = (const char *)data;
+  while (len) {
+    DWORD written = 0;
+    if (!WriteFile(pipe, pos, (DWORD)len, &written, NULL)) return false;
+    pos += written;
+    len -= written;
+  }
+  return true;
+}
+
+static bool send_frame(HANDLE pipe, push_op op, const std::string &name,
+                       const std::string &payload) {
+  push_header header = {};
+  header.op = op;
+  header.name_len = (uint16_t)name.size();
+  header.payload_len = (uint32_t)payload.size();
+
+  return write_all(pipe, &header, sizeof(header)) &&
+         write_all(pipe, name.data(), name.size()) &&
+         write_all(pipe, payload.data(), payload.size());
+}
+
+struct merge_case {
+  const char *name;
+  push_op ops[3];
+  const char *args[3];
+  const char *text;
+  bool reset;
+};
+
+static const merge_case merge_cases[] = {
+    {"append_line accumulates",
+     {PUSH_APPEND_LINE, PUSH_APPEND_LINE, PUSH_APPEND_LINE},
+     {"one", "two", "three"},
+     "one\ntwo\nthree\n",
+     false},
+    {"append accumulates",
+     {PUSH_APPEND, PUSH_APPEND, PUSH_APPEND},
+     {"a", "b", "c"},
+     "abc",
+     false},
+    {"replace then append_line",
+     {PUSH_APPEND_LINE, PUSH_REPLACE, PUSH_APPEND_LINE},
+     {"old", "new", "line"},
+     "newline\n",
+     true},
+    {"clear then append",
+     {PUSH_APPEND, PUSH_CLEAR, PUSH_APPEND},
+     {"old", "", "new"},
+     "new",
+     true},
+};
+
+static int check_merge() {
+  int failed = 0;
+  for (const merge_case &c : merge_cases) {
+    std::string text;
+    bool reset = false;
+    for (int i = 0; i < 3; i++)
+      push_merge(text, reset, c.ops[i], c.args[i], strlen(c.args[i]));
+
+    bool ok = text == c.text && reset == c.reset;
+    printf("%-28s %s\n", c.name, ok ? "ok" : "FAILED");
+    failed += !ok;
+  }
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], "check") == 0) return check_merge();
+
+  if (argc < 3) {
+    fprintf(stderr,
+            "usage: %s <source> replace|append|append_line <text>\n"
+            "       %s <source> clear\n"
+            "       %s <source> bench <count> [bytes]\n"
+            "       %s check\n",
+            argv[0], argv[0], argv[0], argv[0]);
+    return 1;
+  }
+
+  std::string name = argv[1];
+  const char *command = argv[2];
+  const char *arg = argc > 3 ? argv[3] : "";
+
+  HANDLE pipe = open_pipe();
+  if (pipe == INVALID_HANDLE_VALUE) {
+    fprintf(stderr, "could not connect to %ls (error %lu)\n", PUSH_PIPE_NAME,
+            GetLastError());
+    return 1;
+  }
+
+  bool ok = true;
+
+  if (strcmp(command, "replace") == 0) {
+    ok = send_frame(pipe, PUSH_REPLACE, name, arg);
+  } else if (strcmp(command, "append") == 0) {
+    ok = send_frame(pipe, PUSH_APPEND, name, arg);
+  } else if (strcmp(command, "append_line") == 0) {
+    ok = send_frame(pipe, PUSH_APPEND_LINE, name, arg);
+  } else if (strcmp(command, "clear") == 0) {
+    ok = send_frame(pipe, PUSH_CLEAR, name, "");
+  } else if (strcmp(command, "bench") == 0) {
+    long count = strtol(arg, nullptr, 10);
+    long bytes = argc > 4 ? strtol(argv[4], nullptr, 10) : 64;
+    if (count <= 0 || bytes <= 0) {
+      fprintf(stderr, "count and bytes must be positive\n");
+      CloseHandle(pipe);
+      return 1;
+    }
+
+    std::string line((size_t)bytes - 1, 'x');
+    line += '\n';
+
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; ok && i < count; i++)
+      ok = send_frame(pipe, PUSH_APPEND, name, line);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    printf("%ld frames, %.3f s, %.0f frames/s, %.2f MB/s\n", count, seconds,
+           count / seconds, count * (double)bytes / seconds / 1e6);
+  } else {
+    fprintf(stderr, "unknown command '%s'\n", command);
+    ok = false;
+  }
+
+  CloseHandle(pipe);
+  return ok ? 0 : 1;
+}
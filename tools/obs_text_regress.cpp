@@ -0,0 +1,494 @@
+/* Golden-image and timing regression check for the text renderer.
+ *
+ *   obs_text_regress <dir>           compare every case against <dir>
+ *   obs_text_regress <dir> update    write goldens and timings to <dir>
+ *
+ * Each case of the settings matrix below is laid out with DirectWrite,
+ * drawn through the plugin's glyph renderer into a WIC bitmap (the software
+ * target the source uploads from) and composited over its background with
+ * the plugin's kernels. No OBS instance or GPU is needed.
+ *
+ * A case fails when more than 0.1% of its pixels differ from
+ * <dir>\<case>.png by more than 8 in any channel, or when its median render
+ * time is more than 25% and 0.5 ms above the baseline in
+ * <dir>\timings.txt. The exit code is the number of failed cases. Goldens
+ * depend on the installed fonts and DirectWrite version, so record them on
+ * the machine that runs the check. Build with
+ *
+ *   cl /EHsc /std:c++17 /I ..\obs_text_directwrite /I <obs>\libobs
+ *      obs_text_regress.cpp ..\obs_text_directwrite\CustomTextRenderer.cpp
+ *      ..\obs_text_directwrite\GlyphRunCache.cpp
+ *      ..\obs_text_directwrite\Compositing.cpp
+ *      d2d1.lib dwrite.lib windowscodecs.lib ole32.lib <obs>\obs.lib */
+
+#include <windows.h>
+
+#include <d2d1.h>
+#include <dwrite_3.h>
+#include <stdio.h>
+#include <string.h>
+#include <wincodec.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Compositing.h"
+#include "CustomTextRenderer.h"
+#include "GlyphRunCache.h"
+#include "TextUtil.h"
+
+#define RUNS 15
+#define PIXEL_TOLERANCE 8
+#define PIXEL_BUDGET 0.001
+#define TIME_TOLERANCE 0.25
+#define TIME_SLACK_MS 0.5
+
+static const wchar_t *sample_text =
+    L"The quick brown fox jumps over the lazy dog\n"
+    L"[MOD] viewer_42: hello chat\n"
+    L"Sphinx of black quartz, judge my vow\n"
+    L"0123456789 !?&%$#@\n"
+    L"last line of the sample";
+
+struct Case {
+  std::string name;
+  std::wstring text = sample_text;
+  DWRITE_TEXT_ALIGNMENT align = DWRITE_TEXT_ALIGNMENT_LEADING;
+  DWRITE_PARAGRAPH_ALIGNMENT valign = DWRITE_PARAGRAPH_ALIGNMENT_NEAR;
+  bool vertical = false;
+  float outline = 0.f;
+  int gradient = 0;
+  float gradient_dir = 90.f;
+  int chatlog_lines = 0;
+  bool extents = false;
+  bool wrap = true;
+  float extents_cx = 320.f;
+  float extents_cy = 240.f;
+  uint32_t bk_color = 0;
+  uint32_t bk_opacity = 0;
+};
+
+static std::vector<Case> build_matrix() {
+  std::vector<Case> cases;
+  auto add = [&](const std::string &name, auto modify) {
+    Case c;
+    c.name = name;
+    modify(c);
+    cases.push_back(c);
+  };
+
+  add("plain", [](Case &) {});
+
+  const DWRITE_TEXT_ALIGNMENT aligns[] = {DWRITE_TEXT_ALIGNMENT_LEADING,
+                                          DWRITE_TEXT_ALIGNMENT_CENTER,
+                                          DWRITE_TEXT_ALIGNMENT_TRAILING};
+  const DWRITE_PARAGRAPH_ALIGNMENT valigns[] = {
+      DWRITE_PARAGRAPH_ALIGNMENT_NEAR, DWRITE_PARAGRAPH_ALIGNMENT_CENTER,
+      DWRITE_PARAGRAPH_ALIGNMENT_FAR};
+  for (int a = 0; a < 3; a++) {
+    for (int v = 0; v < 3; v++) {
+      add("align_" + std::to_string(a) + "_" + std::to_string(v),
+          [&](Case &c) {
+            c.align = aligns[a];
+            c.valign = valigns[v];
+            c.extents = true;
+            c.extents_cx = 900.f;
+            c.extents_cy = 400.f;
+          });
+    }
+  }
+
+  add("vertical", [](Case &c) { c.vertical = true; });
+  add("vertical_outline", [](Case &c) {
+    c.vertical = true;
+    c.outline = 2.f;
+  });
+
+  for (float size : {1.f, 2.f, 6.f, 12.f})
+    add("outline_" + std::to_string((int)size),
+        [&](Case &c) { c.outline = size; });
+
+  for (int stops = 2; stops <= 4; stops++) {
+    for (float dir : {0.f, 45.f, 90.f, 135.f, 180.f, 270.f, 315.f}) {
+      add("gradient_" + std::to_string(stops) + "_" +
+              std::to_string((int)dir),
+          [&](Case &c) {
+            c.gradient = stops;
+            c.gradient_dir = dir;
+          });
+    }
+  }
+
+  for (int lines : {1, 2, 4})
+    add("chatlog_" + std::to_string(lines),
+        [&](Case &c) { c.chatlog_lines = lines; });
+
+  add("extents_wrap", [](Case &c) { c.extents = true; });
+  add("extents_nowrap", [](Case &c) {
+    c.extents = true;
+    c.wrap = false;
+  });
+  add("background", [](Case &c) {
+    c.bk_color = 0x204080;
+    c.bk_opacity = 60;
+    c.outline = 2.f;
+  });
+
+  return cases;
+}
+
+struct Image {
+  UINT cx = 0;
+  UINT cy = 0;
+  std::vector<uint32_t> pixels;
+};
+
+struct Context {
+  ID2D1Factory *d2d = nullptr;
+  IDWriteFactory4 *dwrite = nullptr;
+  IWICImagingFactory *wic = nullptr;
+};
+
+static void create_brushes(ID2D1RenderTarget *rt, const Case &c, float width,
+                           float height, ID2D1Brush **fill,
+                           ID2D1Brush **outline) {
+  const uint32_t colors[4] = {0xFFFFFF, 0xFF4040, 0x40FF40, 0x4040FF};
+
+  if (c.gradient) {
+    float axis[4] = {0.f, 0.f, width, height};
+    if (width > 0.f && height > 0.f)
+      calculate_gradient_axis(c.gradient_dir, width, height, axis);
+
+    D2D1_GRADIENT_STOP stops[4];
+    float level = 1.f / (c.gradient - 1);
+    for (int i = 0; i < c.gradient; i++) {
+      stops[i].color = D2D1::ColorF(colors[i]);
+      stops[i].position = i == c.gradient - 1 ? 1.f : level * i;
+    }
+
+    ID2D1GradientStopCollection *collection = nullptr;
+    if (SUCCEEDED(rt->CreateGradientStopCollection(
+            stops, c.gradient, D2D1_GAMMA_2_2, D2D1_EXTEND_MODE_MIRROR,
+            &collection))) {
+      rt->CreateLinearGradientBrush(
+          D2D1::LinearGradientBrushProperties(
+              D2D1::Point2F(axis[0], axis[1]), D2D1::Point2F(axis[2], axis[3])),
+          collection, (ID2D1LinearGradientBrush **)fill);
+    }
+    SafeRelease(&collection);
+  } else {
+    rt->CreateSolidColorBrush(D2D1::ColorF(colors[0]),
+                              (ID2D1SolidColorBrush **)fill);
+  }
+
+  if (c.outline > 0.f)
+    rt->CreateSolidColorBrush(D2D1::ColorF(0x000000),
+                              (ID2D1SolidColorBrush **)outline);
+}
+
+/* the same steps RenderText takes for a static source at scale 1 */
+static bool render_case(Context &ctx, GlyphRunCache &cache, const Case &c,
+                        Image &image) {
+  const wchar_t *text = c.text.c_str();
+  size_t len = c.text.size();
+  if (c.chatlog_lines) {
+    const wchar_t *tail = chatlog_tail(text, len, c.chatlog_lines);
+    len -= tail - text;
+    text = tail;
+  }
+
+  IDWriteTextFormat *format = nullptr;
+  IDWriteTextLayout *layout = nullptr;
+  IWICBitmap *bitmap = nullptr;
+  ID2D1RenderTarget *rt = nullptr;
+  ID2D1Brush *fill = nullptr;
+  ID2D1Brush *outline = nullptr;
+  IDWriteTextRenderer1 *renderer = nullptr;
+
+  HRESULT hr = ctx.dwrite->CreateTextFormat(
+      L"Arial", nullptr, DWRITE_FONT_WEIGHT_REGULAR, DWRITE_FONT_STYLE_NORMAL,
+      DWRITE_FONT_STRETCH_NORMAL, 36.f, L"en-US", &format);
+  if (SUCCEEDED(hr)) {
+    format->SetTextAlignment(c.align);
+    format->SetParagraphAlignment(c.valign);
+    format->SetWordWrapping(c.wrap ? DWRITE_WORD_WRAPPING_WRAP
+                                   : DWRITE_WORD_WRAPPING_NO_WRAP);
+    if (c.vertical) {
+      format->SetReadingDirection(DWRITE_READING_DIRECTION_TOP_TO_BOTTOM);
+      format->SetFlowDirection(DWRITE_FLOW_DIRECTION_RIGHT_TO_LEFT);
+    }
+
+    hr = ctx.dwrite->CreateTextLayout(text, (UINT32)len, format,
+                                      c.extents ? c.extents_cx : 1920.f,
+                                      c.extents ? c.extents_cy : 1080.f,
+                                      &layout);
+  }
+
+  float text_cx = 0.f;
+  float line_cy = 0.f;
+  if (SUCCEEDED(hr)) {
+    DWRITE_TEXT_METRICS metrics;
+    hr = layout->GetMetrics(&metrics);
+    text_cx = ceilf(metrics.widthIncludingTrailingWhitespace);
+    line_cy = ceilf(metrics.height) / max(metrics.lineCount, 1U);
+
+    float view_cx = c.extents ? c.extents_cx : text_cx;
+    float view_cy = c.extents ? c.extents_cy : ceilf(metrics.height);
+    view_cx = min(max(view_cx, 2.f), 4096.f);
+    view_cy = min(max(view_cy, 2.f), 4096.f);
+
+    layout->SetMaxWidth(view_cx);
+    layout->SetMaxHeight(view_cy);
+    image.cx = (UINT)ceilf(view_cx);
+    image.cy = (UINT)ceilf(view_cy);
+  }
+  if (SUCCEEDED(hr))
+    hr = ctx.wic->CreateBitmap(image.cx, image.cy,
+                               GUID_WICPixelFormat32bppPBGRA,
+                               WICBitmapCacheOnDemand, &bitmap);
+  if (SUCCEEDED(hr)) {
+    D2D1_RENDER_TARGET_PROPERTIES props = D2D1::RenderTargetProperties(
+        D2D1_RENDER_TARGET_TYPE_SOFTWARE,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM,
+                          D2D1_ALPHA_MODE_PREMULTIPLIED));
+    hr = ctx.d2d->CreateWicBitmapRenderTarget(bitmap, props, &rt);
+  }
+  if (SUCCEEDED(hr)) {
+    create_brushes(rt, c, text_cx, line_cy, &fill, &outline);
+    renderer = fill ? CreateTextRenderer(ctx.d2d, ctx.dwrite, rt, outline,
+                                         fill, c.outline, c.vertical, &cache)
+                    : nullptr;
+    hr = renderer ? S_OK : E_FAIL;
+  }
+  if (SUCCEEDED(hr)) {
+    rt->BeginDraw();
+    rt->Clear(D2D1::ColorF(0, 0.f));
+    layout->Draw(nullptr, renderer, 0.f, 0.f);
+    hr = rt->EndDraw();
+  }
+  if (SUCCEEDED(hr)) {
+    image.pixels.resize((size_t)image.cx * image.cy);
+    hr = bitmap->CopyPixels(nullptr, image.cx * 4,
+                            (UINT)(image.pixels.size() * 4),
+                            (BYTE *)image.pixels.data());
+  }
+  if (SUCCEEDED(hr)) {
+    std::vector<uint32_t> src = image.pixels;
+    composite_over_solid(image.pixels.data(), src.data(), src.size(),
+                         premultiply_color(c.bk_color, c.bk_opacity));
+  }
+  cache.EndRender();
+
+  SafeRelease(&renderer);
+  SafeRelease(&outline);
+  SafeRelease(&fill);
+  SafeRelease(&rt);
+  SafeRelease(&bitmap);
+  SafeRelease(&layout);
+  SafeRelease(&format);
+  return SUCCEEDED(hr);
+}
+
+static std::wstring widen(const std::string &str) {
+  int len = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, nullptr, 0);
+  std::wstring wide(len > 0 ? len - 1 : 0, L'\0');
+  if (len > 1) MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, &wide[0], len);
+  return wide;
+}
+
+/* pixels are stored byte for byte as drawn, so a round trip is exact */
+static bool save_png(Context &ctx, const std::string &path,
+                     const Image &image) {
+  IWICStream *stream = nullptr;
+  IWICBitmapEncoder *encoder = nullptr;
+  IWICBitmapFrameEncode *frame = nullptr;
+  WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+  UINT stride = image.cx * 4;
+
+  HRESULT hr = ctx.wic->CreateStream(&stream);
+  if (SUCCEEDED(hr))
+    hr = stream->InitializeFromFilename(widen(path).c_str(), GENERIC_WRITE);
+  if (SUCCEEDED(hr))
+    hr = ctx.wic->CreateEncoder(GUID_ContainerFormatPng, nullptr, &encoder);
+  if (SUCCEEDED(hr)) hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
+  if (SUCCEEDED(hr)) hr = encoder->CreateNewFrame(&frame, nullptr);
+  if (SUCCEEDED(hr)) hr = frame->Initialize(nullptr);
+  if (SUCCEEDED(hr)) hr = frame->SetSize(image.cx, image.cy);
+  if (SUCCEEDED(hr)) hr = frame->SetPixelFormat(&format);
+  if (SUCCEEDED(hr) && format != GUID_WICPixelFormat32bppBGRA) hr = E_FAIL;
+  if (SUCCEEDED(hr))
+    hr = frame->WritePixels(image.cy, stride, stride * image.cy,
+                            (BYTE *)image.pixels.data());
+  if (SUCCEEDED(hr)) hr = frame->Commit();
+  if (SUCCEEDED(hr)) hr = encoder->Commit();
+
+  SafeRelease(&frame);
+  SafeRelease(&encoder);
+  SafeRelease(&stream);
+  return SUCCEEDED(hr);
+}
+
+static bool load_png(Context &ctx, const std::string &path, Image &image) {
+  IWICBitmapDecoder *decoder = nullptr;
+  IWICBitmapFrameDecode *frame = nullptr;
+  IWICFormatConverter *converter = nullptr;
+
+  HRESULT hr = ctx.wic->CreateDecoderFromFilename(
+      widen(path).c_str(), nullptr, GENERIC_READ,
+      WICDecodeMetadataCacheOnDemand, &decoder);
+  if (SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
+  if (SUCCEEDED(hr)) hr = frame->GetSize(&image.cx, &image.cy);
+  if (SUCCEEDED(hr)) hr = ctx.wic->CreateFormatConverter(&converter);
+  if (SUCCEEDED(hr))
+    hr = converter->Initialize(frame, GUID_WICPixelFormat32bppBGRA,
+                               WICBitmapDitherTypeNone, nullptr, 0.0,
+                               WICBitmapPaletteTypeCustom);
+  if (SUCCEEDED(hr)) {
+    image.pixels.resize((size_t)image.cx * image.cy);
+    hr = converter->CopyPixels(nullptr, image.cx * 4,
+                               (UINT)(image.pixels.size() * 4),
+                               (BYTE *)image.pixels.data());
+  }
+
+  SafeRelease(&converter);
+  SafeRelease(&frame);
+  SafeRelease(&decoder);
+  return SUCCEEDED(hr);
+}
+
+/* pixels with any channel further apart than the tolerance */
+static size_t count_differences(const Image &a, const Image &b) {
+  size_t count = 0;
+  for (size_t i = 0; i < a.pixels.size(); i++) {
+    uint32_t x = a.pixels[i];
+    uint32_t y = b.pixels[i];
+    for (int shift = 0; shift < 32; shift += 8) {
+      int d = (int)((x >> shift) & 0xFF) - (int)((y >> shift) & 0xFF);
+      if (d > PIXEL_TOLERANCE || d < -PIXEL_TOLERANCE) {
+        count++;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+static std::map<std::string, double> load_timings(const std::string &path) {
+  std::map<std::string, double> timings;
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file) return timings;
+
+  char name[256];
+  double ms;
+  while (fscanf(file, "%255s %lf", name, &ms) == 2) timings[name] = ms;
+  fclose(file);
+  return timings;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || (argc > 2 && strcmp(argv[2], "update") != 0)) {
+    fprintf(stderr, "usage: %s <dir> [update]\n", argv[0]);
+    return -1;
+  }
+
+  std::string dir = argv[1];
+  bool update = argc > 2;
+
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+  Context ctx;
+  HRESULT hr =
+      D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &ctx.d2d);
+  if (SUCCEEDED(hr))
+    hr = DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED,
+                             __uuidof(IDWriteFactory4),
+                             reinterpret_cast<IUnknown **>(&ctx.dwrite));
+  if (SUCCEEDED(hr))
+    hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr,
+                          CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&ctx.wic));
+  if (FAILED(hr)) {
+    fprintf(stderr, "cannot create D2D, DirectWrite or WIC (0x%08lX)\n", hr);
+    return -1;
+  }
+
+  std::string timings_path = dir + "\\timings.txt";
+  std::map<std::string, double> baseline = load_timings(timings_path);
+  FILE *timings = update ? fopen(timings_path.c_str(), "w") : nullptr;
+  if (update && !timings) {
+    fprintf(stderr, "cannot write %s\n", timings_path.c_str());
+    return -1;
+  }
+
+  int failed = 0;
+  for (const Case &c : build_matrix()) {
+    GlyphRunCache cache;
+    Image image;
+    std::vector<double> times;
+    bool rendered = true;
+
+    for (int run = 0; run < RUNS && rendered; run++) {
+      auto start = std::chrono::steady_clock::now();
+      rendered = render_case(ctx, cache, c, image);
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      times.push_back(elapsed.count());
+    }
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    std::string golden_path = dir + "\\" + c.name + ".png";
+
+    if (!rendered) {
+      printf("FAIL %-24s render failed\n", c.name.c_str());
+      failed++;
+      continue;
+    }
+
+    if (update) {
+      bool saved = save_png(ctx, golden_path, image);
+      fprintf(timings, "%s %.4f\n", c.name.c_str(), median);
+      printf("%s %-24s %8.3f ms\n", saved ? "save" : "FAIL", c.name.c_str(),
+             median);
+      if (!saved) failed++;
+      continue;
+    }
+
+    Image golden;
+    const char *problem = nullptr;
+    size_t differences = 0;
+
+    if (!load_png(ctx, golden_path, golden)) {
+      problem = "no golden image, run with update";
+    } else if (golden.cx != image.cx || golden.cy != image.cy) {
+      problem = "size differs from golden image";
+    } else {
+      differences = count_differences(golden, image);
+      if (differences > golden.pixels.size() * PIXEL_BUDGET)
+        problem = "pixels differ from golden image";
+    }
+
+    auto base = baseline.find(c.name);
+    if (!problem && base != baseline.end() &&
+        median > base->second * (1.0 + TIME_TOLERANCE) &&
+        median - base->second > TIME_SLACK_MS)
+      problem = "slower than baseline";
+
+    printf("%s %-24s %8.3f ms (baseline %.3f) %zu pixels differ%s%s\n",
+           problem ? "FAIL" : "ok  ", c.name.c_str(), median,
+           base != baseline.end() ? base->second : 0.0, differences,
+           problem ? ": " : "", problem ? problem : "");
+    if (problem) failed++;
+  }
+
+  if (timings) fclose(timings);
+  SafeRelease(&ctx.wic);
+  SafeRelease(&ctx.dwrite);
+  SafeRelease(&ctx.d2d);
+  CoUninitialize();
+
+  printf("%d failed\n", failed);
+  return failed;
+}